@@ -16,6 +16,7 @@
 //===----------------------------------------------------------------------===//
 
 #include "llvm/ADT/Statistic.h"
+#include "llvm/ADT/DenseMap.h"
 #include "llvm/IR/Module.h"
 #include "llvm/IR/Function.h"
 #include "llvm/IR/BasicBlock.h"
@@ -32,19 +33,40 @@
 #include "llvm/Analysis/RegionIterator.h"
 #include "llvm/Analysis/BlockFrequencyInfo.h"
 #include "llvm/Analysis/BlockFrequencyInfoImpl.h"
+#include "llvm/Analysis/BranchProbabilityInfo.h"
 #include "llvm/Pass.h"
 #include "llvm/Support/raw_ostream.h"
 #include "llvm/Support/Debug.h"
+#include "llvm/Support/CommandLine.h"
 #include "llvm/Analysis/TargetLibraryInfo.h"
+#include "llvm/Analysis/AssumptionCache.h"
+#include "llvm/IR/Dominators.h"
+#include "llvm/IR/LegacyPassManager.h"
+#include "llvm/ADT/Triple.h"
+#include "llvm/Support/ThreadPool.h"
+#include "llvm/Support/Timer.h"
 #include "llvm/Transforms/Utils/Local.h"
 #include <string>
 #include <iostream>
 #include <fstream>
 #include <iomanip>
 #include <algorithm>
+#include <memory>
+#include <mutex>
+#include <thread>
 #include "llvm/IR/CFG.h"
 #include "../Identify.h" // Common Header file for all RegionSeeker Passes.
 #include "FunctionSignature.h"
+#include "FunctionSignatureOutput.h"
+#include "FunctionSignatureAnalyzer.h"
+#include "FunctionSignatureCache.h"
+#include "FunctionSignatureAnalysis.h"
+#include "FunctionSignatureCallGraph.h"
+#include "FunctionSignatureDependence.h"
+#include "FunctionSignatureSketch.h"
+#include "FunctionSignaturePipeline.h"
+#include "FunctionSignatureProfile.h"
+#include "FunctionSignatureRoofline.h"
 
 #include "llvm/IR/DebugInfoMetadata.h"
 #include "llvm/IR/DebugInfo.h"
@@ -53,468 +75,458 @@
 
 using namespace llvm;
 
-namespace {
-
-  struct FunctionSignature : public FunctionPass {
-    static char ID; // Pass Identification, replacement for typeid
-
-    std::vector<Loop *> Loops_list; // Global Loop List
-    std::vector<Function *> Functions_list; // Global Loop List
-    std::vector<unsigned int> Functions_instr_list; // Global Loop List
+STATISTIC(NumFunctions,    "Number of Functions analyzed");
+STATISTIC(NumBlocks,       "Number of basic blocks analyzed");
+STATISTIC(NumLoops,        "Number of Loops summarized");
+STATISTIC(NumLoads,        "Number of loads");
+STATISTIC(NumStores,       "Number of stores");
+STATISTIC(NumTypeWalks,    "Number of argument types walked");
+STATISTIC(NumTypeHits,     "Number of argument types found in the type cache");
+STATISTIC(NumCacheHits,    "Number of records reused from -fsig-cache");
+STATISTIC(NumProfiled,     "Number of functions given their entry count by -fsig-profile");
+STATISTIC(NumUnprofiled,   "Number of functions missing or ambiguous in -fsig-profile");
+
+static cl::opt<std::string> OutputFilename("fsig-output",
+  cl::desc("Write the FunctionSignature records to <file> (default: stderr)"),
+  cl::value_desc("file"), cl::init("-"));
+
+static cl::opt<SignatureFormat> OutputFormat("fsig-format",
+  cl::desc("Format of the FunctionSignature records"), cl::init(FSIG_TEXT),
+  cl::values(
+    clEnumValN(FSIG_TEXT, "text", "Legacy F[...] text records"),
+    clEnumValN(FSIG_JSON, "json", "Versioned JSON lines, one Function per line"),
+    clEnumValN(FSIG_NPY, "npy", "Columnar int64 feature matrices, saved under the output prefix"),
+    clEnumValEnd));
+
+static cl::opt<AnalysisLevel> Level("fsig-level",
+  cl::desc("Analysis tier of FunctionSignature"), cl::init(FSIG_STANDARD),
+  cl::values(
+    clEnumValN(FSIG_CHEAP, "cheap", "Instruction counts and signatures only"),
+    clEnumValN(FSIG_STANDARD, "standard", "Add loops and SCEV"),
+    clEnumValN(FSIG_DEEP, "deep", "Add dependence distances and memory access patterns"),
+    clEnumValEnd));
+
+static cl::opt<std::string> CacheFilename("fsig-cache",
+  cl::desc("Reuse the records of unchanged Functions from <file>, and update it"),
+  cl::value_desc("file"));
+
+static cl::list<double> Balance("fsig-balance",
+  cl::desc("Machine balance points in operations per byte, to classify the roofline bound of Functions and loops"),
+  cl::CommaSeparated, cl::value_desc("ops/byte,..."));
+
+static cl::opt<std::string> LatencyFilename("fsig-latencies",
+  cl::desc("Estimate the initiation intervals of innermost loops with the latencies and ports of <file>"),
+  cl::value_desc("file"));
+
+static cl::opt<double> SimilarityThreshold("fsig-similarity",
+  cl::desc("Report the pairs of Functions whose MinHash sketches are at least this similar (0: off)"),
+  cl::init(0));
+
+static cl::opt<std::string> ProfileFilename("fsig-profile",
+  cl::desc("Take the entry counts of the Functions from an indexed <file>.profdata"),
+  cl::value_desc("file"));
+
+static cl::opt<unsigned> Threads("fsig-threads",
+  cl::desc("Worker threads of FunctionSignatureParallel (0: one per core)"),
+  cl::init(0));
+
+// S[...] records of the similar Functions of the Module, found through the
+// LSH index of their sketches.
+//
+static void writeSimilarFunctions(SignatureOutput &Output, const std::vector<FunctionRecord> &Records) {
 
-    FunctionSignature() : FunctionPass(ID) {}
+  std::vector<SimilarPair> Pairs;
 
-    // Function Identifier
-    //
-    bool runOnFunction(Function &F) override {
+  if (SimilarityThreshold <= 0)
+    return;
 
-      LoopInfo &LI = getAnalysis<LoopInfoWrapperPass>().getLoopInfo();
-      ScalarEvolution &SE = getAnalysis<ScalarEvolutionWrapperPass>().getSE();
-      std::string Function_Name = F.getName();
+  findSimilarFunctions(Records, SimilarityThreshold, Pairs);
 
-      Loops_list.clear(); // Clear the Loops List
-
-      if (find_function(Functions_list, &F) == -1) 
-        Functions_list.push_back(&F);
+  for (unsigned i = 0; i < Pairs.size(); i++)
+    Output.writeSimilar(Records, Pairs[i]);
+}
 
-      gatherNumberOfInstructionsOfFunction(&F);
-      int FuncFreq = getEntryCount(&F);
+// Add a record to the -stats counters.
+//
+static void countRecord(const FunctionRecord &Record) {
 
-      errs() << "\n\n" <<"F[name:" <<Function_Name << "; call_freq:" << FuncFreq <<
-       "; n_of_instructions:" <<  
-        Functions_instr_list[ find_function(Functions_list, &F)] << "] {\n";
-      // errs() << "   **********************************************" << '\n';
+  NumFunctions++;
+  NumBlocks += Record.Blocks.size();
+  NumLoads += Record.Features.Loads;
+  NumStores += Record.Features.Stores;
 
-      getInputFunction(&F);
-      getLoadsStoresLoopsOfFunction(&F, LI, SE);
-      errs() << " }" << '\n';
+  for (unsigned b = 0; b < Record.Blocks.size(); b++)
+    if (Record.Blocks[b].HasLoop)
+      NumLoops++;
+}
 
+// Attach the entry counts of -fsig-profile to the Functions of M, before any
+// of them is analyzed or hashed. Returns whether M was changed.
+//
+static bool annotateProfile(Module &M) {
 
-      return false;
-    }
+  ProfileAnnotator Profile;
+  std::string Error;
 
+  if (ProfileFilename.empty())
+    return false;
 
+  if (!Profile.load(ProfileFilename, Error))
+    report_fatal_error(Twine("FunctionSignature: cannot read profile '") + ProfileFilename + "': " + Error);
 
-    void gatherNumberOfInstructionsOfFunction(Function *F) {
+  Profile.annotate(M);
 
-      unsigned int NumberOfLLVMInstructions=0;
+  NumProfiled += Profile.getNumberOfMatched();
+  NumUnprofiled += Profile.getNumberOfAmbiguous() + Profile.getNumberOfMissing();
 
-      for(Function::iterator BB = F->begin(), E = F->end(); BB != E; ++BB)
-          // Iterate inside the basic block.
-        for(BasicBlock::iterator BI = BB->begin(), BE = BB->end(); BI != BE; ++BI)
-          NumberOfLLVMInstructions++;
+  return Profile.getNumberOfMatched();
+}
 
-      Functions_instr_list.push_back(NumberOfLLVMInstructions);   
-    }
+// Latency table of -fsig-latencies, or the defaults without it.
+//
+static LatencyTable Latencies;
 
+static void loadLatencies() {
 
+  std::string Error;
 
-    //
-    void getCallInstrOfBB (BasicBlock *BB) {
-
-      // Iterate inside the basic block.
-      for(BasicBlock::iterator BI = BB->begin(), BE = BB->end(); BI != BE; ++BI) {
-
-             // Load Info
-        if(CallInst *CI = dyn_cast<CallInst>(&*BI)) {
-
-          StringRef CallName = CI->getCalledFunction()->getName();
-          
-          if (CallName == "llvm.dbg.value" || CallName == "llvm.lifetime.start" || CallName == "llvm.lifetime.start" ||
-              CallName == "llvm.lifetime.end")
-            continue;
-
-          errs() 
-          // <<  *CI  <<"\n"
-          // << "OP1: " << *CI->getOperand(0) <<"\n"
-          // << "OP2 " << *CI->getOperand(1) <<"\n"
-          << "\t\tC[name: " << CI->getCalledFunction()->getName() 
-          <<"; n_of_instructions:" <<  Functions_instr_list[ find_function(Functions_list, CI->getCalledFunction())] 
-          << "]\n";
-        }
-      }
-    }
+  if (!LatencyFilename.empty() && !Latencies.load(LatencyFilename, Error))
+    report_fatal_error(Twine("FunctionSignature: cannot read latencies '") + LatencyFilename + "': " + Error);
+}
 
-    // Get Loads and Stores of a BB 
-    //
-    //
-    void getLoadsandStoresOfBB (BasicBlock *BB) {
+static void countCaches(const TypeSizeCache &Types, const SignatureCache &Cache) {
 
+  NumTypeWalks += Types.getNumberOfWalks();
+  NumTypeHits += Types.getNumberOfHits();
+  NumCacheHits += Cache.getNumberOfHits();
+}
 
-      // Iterate inside the basic block.
-      for(BasicBlock::iterator BI = BB->begin(), BE = BB->end(); BI != BE; ++BI) {
+namespace {
 
-        // Load Info
-        if(LoadInst *Load = dyn_cast<LoadInst>(&*BI)) {
-          llvm::Type *LoadType = Load->getType();
-          errs() << "\t\tR[addr:" << Load <<"; name:" << Load->getOperand(0)->getName() << "; offset:" << "NA;]" << "\n";
-        }
+  struct FunctionSignature : public FunctionPass {
+    static char ID; // Pass Identification, replacement for typeid
 
-        // Store Info
-        if(StoreInst *Store = dyn_cast<StoreInst>(&*BI)) {
+    SignatureRegistry Registry; // Functions seen so far.
+    std::unique_ptr<TypeSizeCache> Types; // Type sizes of the Module.
+    std::unique_ptr<SignatureOutput> Output; // Buffered sink of the records.
+    SignatureCache Cache; // Records of the previous run, with -fsig-cache.
+    std::vector<FunctionRecord> Records; // Written once their inclusive costs are known.
+    std::unique_ptr<SignatureTimers> Timers; // With -time-passes.
+    std::unique_ptr<legacy::FunctionPassManager> DependencePasses; // Deep tier, on cache misses only.
+    LoopDependencePass *Dependences; // Owned by DependencePasses.
 
-          llvm::Type *StoreOperandZeroType = Store->getOperand(0)->getType();
-          llvm::Type *StoreOperandOneType = Store->getOperand(1)->getType();
+    FunctionSignature() : FunctionPass(ID), Dependences(nullptr) {}
 
-          // if (StoreOperandZeroType->isIntegerTy())
-          if (AllocaInst *alloca = dyn_cast<AllocaInst>(Store->getOperand(1))) 
-            continue;
-          
-          else 
-            errs() << "\t\tW[addr:" << Store <<"; name:" << Store->getOperand(1)->getName() << "; offset:" << "NA;]"  <<"\n";
-        }
-      } // End of BB For  
+    bool doInitialization(Module &M) override {
 
+      if (TimePassesIsEnabled && !Timers)
+        Timers.reset(new SignatureTimers());
 
-    }
-    
+      Types.reset(new TypeSizeCache(M.getDataLayout()));
+      Output.reset(new SignatureOutput(OutputFilename, OutputFormat));
+      Output->writeHeader(M.getModuleIdentifier());
 
-    // Loops Identifier of a given function. (if any loops)
-    //
-    void getLoadsStoresLoopsOfFunction (Function *F, LoopInfo &LI, ScalarEvolution &SE ) {
+      if (!CacheFilename.empty())
+        Cache.load(CacheFilename);
 
-      unsigned int NumberOfBBInstructions = 0 ; // NumberOfInstructions = 0,
+      loadLatencies();
 
-      for(Function::iterator BB = F->begin(), E = F->end(); BB != E; ++BB) {
-
-        BasicBlock *CurrentBlock = &*BB;
-        unsigned int NumberOfBBInstructions = 0 ; // NumberOfInstructions = 0,
-
-        for(BasicBlock::iterator BI = CurrentBlock->begin(), BE = CurrentBlock->end(); BI != BE; ++BI)
-              NumberOfBBInstructions++;
-          
-          errs() << "\n\tBB[name:" << CurrentBlock->getName() 
-            <<"; n_of_instructions:" <<  NumberOfBBInstructions << "]\n";
+      // DependenceAnalysis is the most expensive analysis of the deep tier:
+      // it runs in a pass manager of its own, only for the Functions the
+      // Cache misses, instead of being required by this pass.
+      if (Level >= FSIG_DEEP) {
+        DependencePasses.reset(new legacy::FunctionPassManager(&M));
+        Dependences = new LoopDependencePass();
+        DependencePasses->add(Dependences);
+        DependencePasses->doInitialization();
+      }
 
-        
-        // If-Else Analsyis (Branch Instructions Analysis)
-        //           
-        for(BasicBlock::iterator BI = CurrentBlock->begin(), BE = CurrentBlock->end(); BI != BE; ++BI)    
-          if (BranchInst *BRI = dyn_cast<BranchInst>(&*BI)){
-        
+      return annotateProfile(M);
+    }
 
-            if (BRI->isConditional()) { 
-              unsigned int NumOfSuccessors = BRI->getNumSuccessors();
+    bool doFinalization(Module &M) override {
 
-              for (unsigned int i=0; i< NumOfSuccessors; i++)
-                errs() << "\n\t  BranchInst (IF=0,ELSE=1): " << i << "\tSuccessor BB: " << BRI->getSuccessor(i)->getName();
-            }
+      if (!CacheFilename.empty())
+        Cache.save(CacheFilename);
 
-          }
+      if (DependencePasses) {
+        DependencePasses->doFinalization();
+        DependencePasses.reset();
+        Dependences = nullptr;
+      }
 
-        
+      {
+        TimeRegion Region(Timers ? &Timers->Output : nullptr);
 
-        // Iterate inside the Loop.
-        if (Loop *L = LI.getLoopFor(CurrentBlock)) {
-           if (find_loop(Loops_list, L) == -1) { // If Loop not in our list
-              Loops_list.push_back(L);
-              int LoopCarriedDeps = getLoopCarriedDependencies(CurrentBlock);
+        computeInclusiveCosts(Records);
+        computeRooflines(Records, Balance);
 
-              if (const SCEV *ScEv = SE.getBackedgeTakenCount(L) ) {
+        for (unsigned i = 0; i < Records.size(); i++)
+          Output->write(Records[i]);
 
-                //errs() << "\n\n I am here 5\n "; 
-                ConstantRange Range = SE.getSignedRange(ScEv);
-                int stride = 0;
+        writeSimilarFunctions(*Output, Records);
+        Output->flush();
+      }
 
-                //errs() << "\n\n I am here 6\n "; 
+      countCaches(*Types, Cache);
+      Records.clear();
+      Output.reset(); // Flush the records.
+      Types.reset();
 
+      return false;
+    }
 
-                if (SE.getSmallConstantTripCount(L))
-                  stride = Range.getUpper().getLimitedValue() / SE.getSmallConstantTripCount(L);
+    // Function Identifier
+    //
+    bool runOnFunction(Function &F) override {
 
-                 //errs() << "\n\n I am here 7\n "; 
+      LoopInfo *LI = nullptr;
+      ScalarEvolution *SE = nullptr;
+      BlockFrequencyInfo *BFI = nullptr;
+      FunctionRecord Record;
+      FunctionSignatureAnalyzer Analyzer(Registry, *Types);
+      uint64_t Key = 0;
 
-                errs() << "\n\t  L[name:" << CurrentBlock->getName() << "; depth:" << L->getLoopDepth()
-                  << "; iterations:" << SE.getSmallConstantTripCount(L) 
-                  << "; stride:" << stride 
-                  << "; lcds:" << LoopCarriedDeps               
-                  <<"; n_of_instructions:" <<  NumberOfBBInstructions
-                  << "] {\n";
+      Analyzer.setTimers(Timers.get());
+      Analyzer.setLatencies(&Latencies);
+      const FunctionRecord *Cached = nullptr;
 
-                 getLoadsandStoresOfBB(CurrentBlock);
-                 getCallInstrOfBB(CurrentBlock);
+      if (!CacheFilename.empty()) {
+        Key = FunctionHasher().hash(F, Level, Registry, Latencies.hash());
+        Cached = Cache.lookup(Key);
+      }
 
-                // errs() << "      Signed Range of Backedge Taken Count        : " << SE.getSignedRange(ScEv) << '\n';      
-                // errs() << "      Range of Backedge Taken Count is            : " << Range.getUpper() - Range.getLower() << '\n';
-                // errs() << "      Upper Range of Backedge Taken Count         : " << Range.getUpper()<< '\n';
-                // errs() << "      Loop disposition of Backedge Taken Count is : " << SE.getLoopDisposition(ScEv, L) << "\n\n\n";
-                errs() <<  "\t  }\n";
-            }
-          
-          }
+      if (Cached) {
+        Record = *Cached;
+        Analyzer.relink(F, Record);
+      }
+      else {
+        if (Level >= FSIG_STANDARD) {
+          LI = &getAnalysis<LoopInfoWrapperPass>().getLoopInfo();
+          SE = &getAnalysis<ScalarEvolutionWrapperPass>().getSE();
+          BFI = &getAnalysis<BlockFrequencyInfoWrapperPass>().getBFI();
         }
 
-        else { // No loops
-          // for(BasicBlock::iterator BI = CurrentBlock->begin(), BE = CurrentBlock->end(); BI != BE; ++BI)
-          //   NumberOfInstructions++;
-
-           getLoadsandStoresOfBB(CurrentBlock);
-            getCallInstrOfBB(CurrentBlock);
+        if (Dependences) {
+          DependencePasses->run(F);
+          Analyzer.setDependences(&Dependences->getLoops());
         }
-      } // End of for
-      // errs() << "   ----------------------------------------------" << '\n';
-      // errs() << " Number of Instructions                  : " << NumberOfAllInstructions << "\n";
-      // errs() << " Number of Instructions (Loops Excluded) : " << NumberOfInstructions << "\n";
-      // errs() << "   ----------------------------------------------" << '\n';
-    }
-
-
-
-    // Metadata Information
-
-  void getFunctionSignature(Function *F) {
-
-
 
-    if (F->hasMetadata()) {
-
-      MDNode *node = F->getMetadata("dbg");
-
-      // errs() << node->getMetadataID() << "\n";
-      llvm::DISubprogram *SP = F->getSubprogram();
-      unsigned scopeline = SP->getScopeLine();
-      unsigned line = SP->getLine();
+        Analyzer.analyze(F, LI, SE, BFI, Record, Level);
+      }
 
-       llvm::DIScope *Scope = dyn_cast<DIScope>(SP->getScope());
+      if (!CacheFilename.empty())
+        Cache.insert(Key, Record);
 
-      errs() << "file: " << Scope->getDirectory()  // << "\n";
-             << "/" << Scope->getFilename() << ";";
+      // F may have changed since it was counted as a callee.
+      Registry.setNumberOfInstructions(&F, Record.Features.NumberOfInstructions);
 
-      errs() << " line_number: " << line << ";]";
+      countRecord(Record);
+      Records.push_back(std::move(Record));
 
+      return false;
     }
 
-  }
-
-
-  // START 
-  // IMPORT FROM ACCELSEEKER FUNCTIONS
-  //
-  //
-  bool structNameIsValid(llvm::Type *type) {
+    // Only request what the selected tier uses. DependenceAnalysis is run on
+    // demand, through DependencePasses.
+    virtual void getAnalysisUsage(AnalysisUsage& AU) const override {
 
-    if (type->getStructName() == "struct._IO_marker")
-      return 0;
-    if (type->getStructName() == "struct._IO_FILE")
-      return 0;
+        if (Level >= FSIG_STANDARD) {
+          AU.addRequired<LoopInfoWrapperPass>();
+          AU.addRequiredTransitive<ScalarEvolutionWrapperPass>();
+          AU.addRequired<BlockFrequencyInfoWrapperPass>();
+        }
+        AU.setPreservesAll();
+    } 
+  };
+}
 
 
-    return 1;
-  }
+namespace {
 
-  // Gather the data of the Array type.
+  // Module-level driver of the same analysis. LoopInfo and ScalarEvolution are
+  // computed per Function on a thread pool, each Function fills its own
+  // record, and the records are printed in Module order so that the output
+  // matches the one of FunctionSignature.
   //
-  long int getTypeArrayData(llvm::Type *type) {
-
-    long int array_data=0;
-    int TotalNumberOfArrayElements = 1;
+  struct FunctionSignatureParallel : public ModulePass {
+    static char ID; // Pass Identification, replacement for typeid
 
-    while (type->isArrayTy()) {
+    FunctionSignatureParallel() : ModulePass(ID) {}
 
-      llvm::Type *array_type    = type->getArrayElementType();
-      int NumberOfArrayElements     = type->getArrayNumElements();
-      int SizeOfElement           = array_type->getPrimitiveSizeInBits();
+    bool runOnModule(Module &M) override {
 
-     // errs() << "\n\t Array " << *array_type << " "  << NumberOfArrayElements<< " " << SizeOfElement  << " \n ";
-      errs() << "\t A[name:" 
-        // << *type
-        // << *array_type
-         // << array_type
-         //     << &type
-        << " NA" 
-        <<"; type:" << *array_type 
-        << "; n_bit:" << SizeOfElement << "; size:"  << NumberOfArrayElements << ";];" ;
+      bool Changed = annotateProfile(M); // Metadata is not thread safe; before the workers.
+      loadLatencies();
+      SignatureRegistry Registry;
+      TypeSizeCache Types(M.getDataLayout());
+      std::vector<Function *> Functions;
 
-      TotalNumberOfArrayElements *= NumberOfArrayElements;
+      // Count every Function and lay out every struct up front, so that the
+      // workers only read the Registry and the DataLayout.
+      for (Module::iterator F = M.begin(), E = M.end(); F != E; ++F) {
+        Registry.addFunction(&*F);
 
-      if (SizeOfElement) {
-        array_data = TotalNumberOfArrayElements * SizeOfElement;
-        return array_data ;
+        if (!F->isDeclaration())
+          Functions.push_back(&*F);
       }
-      else
-        type = array_type;
-    }
-    return array_data;  
-  }
-
-  long int getTypeData(llvm::Type *type){
-
-    long int arg_data =0;
-
-    if ( type->isPointerTy()){
-       errs() << "*";
-
-
-      llvm::Type *Pointer_Type = type->getPointerElementType();
-      arg_data+=getTypeData(Pointer_Type);
-    }
-
-    // Struct Case
-    else if ( type->isStructTy()) {
 
-      long int struct_data=0;
-      unsigned int NumberOfElements = type->getStructNumElements();
-
-      errs() << " S["  << type->getStructName() << ";";
-
-      StructType *struct_type = dyn_cast<StructType>(&*type);
-      int i=0;
-
-      for  (llvm::StructType::element_iterator  EI= struct_type->element_begin(), EE = struct_type->element_end(); EI != EE; ++EI, i++){
-
-  
-        llvm::Type *element_type = type->getStructElementType(i);
-
-        errs() << "\n\t\taddr:" << EI << ";"; 
+      Types.layoutStructs(M);
+
+      std::vector<FunctionRecord> Records(Functions.size());
+      std::vector<uint64_t> Keys(Functions.size());
+      TargetLibraryInfoImpl TLII(Triple(M.getTargetTriple()));
+      SignatureCache Cache;
+
+      // The workers only read the IR, its metadata and the DataLayout, and
+      // take ContextLock around everything that creates uniqued constants,
+      // types or value handles in the shared LLVMContext: the creation,
+      // queries and teardown of ScalarEvolution and AssumptionCache. The
+      // dependences are collected on this thread, which does the same, only
+      // while no worker runs.
+      std::mutex ContextLock;
+
+      if (!CacheFilename.empty())
+        Cache.load(CacheFilename);
+
+      {
+        // hardware_concurrency() is 0 when it is not known, and a pool without threads never runs.
+        unsigned int NumberOfThreads = Threads ? Threads : std::max(1u, std::thread::hardware_concurrency());
+        ThreadPool Pool(NumberOfThreads);
+
+        // The legacy pass manager that runs DependenceAnalysis is not thread
+        // safe, and its ScalarEvolution and DependenceAnalysis share the
+        // LLVMContext with the workers. In the deep tier the Functions go in
+        // batches: the dependences of a batch are collected on this thread,
+        // only for the Functions the Cache misses, before its workers start,
+        // and the next batch waits for them. Below the deep tier all the
+        // Functions are one batch.
+        size_t BatchSize = Level >= FSIG_DEEP ? 4 * NumberOfThreads : Functions.size();
+
+        for (size_t Begin = 0; Begin < Functions.size(); Begin += BatchSize) {
+
+          size_t End = std::min(Begin + BatchSize, Functions.size());
+          std::vector<std::shared_ptr<LoopDependenceMap> > Dependences(End - Begin); // Freed with the tasks.
+
+          if (Level >= FSIG_DEEP)
+            for (size_t i = Begin; i < End; i++) {
+
+              if (!CacheFilename.empty())
+                Keys[i] = FunctionHasher().hash(*Functions[i], Level, Registry, Latencies.hash());
+
+              if (CacheFilename.empty() || !Cache.lookup(Keys[i])) {
+                LoopDependencePass &Pass = getAnalysis<LoopDependencePass>(*Functions[i]);
+                Dependences[i - Begin] = std::make_shared<LoopDependenceMap>(Pass.getLoops());
+              }
+            }
 
-        if (structNameIsValid(type))
-          struct_data +=  getTypeData(element_type);
+          for (size_t i = Begin; i < End; i++) {
+            std::shared_ptr<LoopDependenceMap> FunctionDependences = Dependences[i - Begin];
 
+            Pool.async([&, i, FunctionDependences]() {
+              analyzeFunction(*Functions[i], TLII, Registry, Types, Cache, ContextLock, FunctionDependences.get(),
+                              Records[i], Keys[i]);
+            });
+          }
 
+          Pool.wait();
+        }
       }
 
+      computeInclusiveCosts(Records);
+      computeRooflines(Records, Balance);
 
-      errs() << "];";
-  
-      arg_data = struct_data;
-      //return arg_data;    
-    }
-
-    // Scalar Case
-    else if ( type->getPrimitiveSizeInBits()) {
-      //errs() << "\n\t Primitive Size  " <<  type->getPrimitiveSizeInBits()  << " \n ";
-      arg_data = type->getPrimitiveSizeInBits();
-      errs() << "i" << arg_data;
-      //return arg_data;
-
-    }
- 
-    // Vector Case
-    else if ( type->isVectorTy()) {
-      //errs() << "\n\t Vector  " <<  type->getPrimitiveSizeInBits()  << " \n ";
-      arg_data = type->getPrimitiveSizeInBits();
-      //return arg_data;
-    }
-
-
-    // Array Case
-    else if(type->isArrayTy()) {
-      arg_data = getTypeArrayData(type);
-      //errs() << "\n\t Array Data " << arg_data << " \n ";
-      //return arg_data;
-    }
-
-    return arg_data;
-  }
-
-    // Input from parameter List.
-    //
-    //
-    long int getInputFunction(Function *F) {
-      long  int InputData = 0; // Bits
-      long int InputDataBytes = 0; // Bytes
-
-      int arg_index=0;
+      SignatureOutput Output(OutputFilename, OutputFormat);
+      Output.writeHeader(M.getModuleIdentifier());
 
-      Function::ArgumentListType & Arg_List = F->getArgumentList();
+      for (unsigned i = 0; i < Records.size(); i++)
+        Output.write(Records[i]);
 
-      for (Function::arg_iterator AB = Arg_List.begin(), AE = Arg_List.end(); AB != AE; ++AB){
+      writeSimilarFunctions(Output, Records);
 
-        llvm::Argument *Arg = &*AB;
-        llvm::Type *Arg_Type = Arg->getType();
+      if (!CacheFilename.empty()) {
+        for (unsigned i = 0; i < Records.size(); i++)
+          Cache.insert(Keys[i], Records[i]);
 
+        Cache.save(CacheFilename);
+      }
 
-         errs() << "\t P[addr:" << Arg <<"; name:" << AB->getName() << "; type:";
-
-        long int InputDataOfArg = getTypeData(Arg_Type);
-        errs() << " n_bit:" << InputDataOfArg << "; size:";
-        //<< "NA"
-        getFunctionSignature(F);
-        errs() << "]\n";
-
-        InputData += InputDataOfArg;
-        arg_index++;
-
-       }
+      for (unsigned i = 0; i < Records.size(); i++)
+        countRecord(Records[i]);
 
-       // errs() << "\n\n Total Input Data Bits :  " << InputData << " \n ";
-       InputDataBytes = InputData/8; 
-       // errs() << "\n\n Total Input Data Bytes :  " << InputDataBytes << " \n ";
+      countCaches(Types, Cache);
 
-      return InputDataBytes;
+      return Changed;
     }
 
-    // Gather Stores and Loads from Functions
-    //
-    //
-    void gatherLoadsandStores(Function *F) {
-      long unsigned int NumberOfInstructions = 0;
-
-      // BlockFrequencyInfo *BFI = &getAnalysis<BlockFrequencyInfoWrapperPass>().getBFI(); 
-
-
-      for(Function::iterator BB = F->begin(), E = F->end(); BB != E; ++BB) {
-        BasicBlock *CurrentBlock = &*BB;
-
-
-        errs() << "BB " << CurrentBlock->getName() << "\n";
-
-        // Iterate inside the basic block.
-        for(BasicBlock::iterator BI = CurrentBlock->begin(), BE = CurrentBlock->end(); BI != BE; ++BI) {
-
-          // Load Info
-          if(LoadInst *Load = dyn_cast<LoadInst>(&*BI)) {
-
-            llvm::Type *LoadType = Load->getType();
-            // llvm::Type *Ptr_LoadType = NULL;
-
-            if ( LoadType->isPointerTy()) {
-              llvm::Type *Ptr_LoadType = LoadType->getPointerElementType();
-
-               if (Ptr_LoadType->isStructTy() || Ptr_LoadType->isArrayTy() || Ptr_LoadType->isVectorTy()) {
-                  errs() << "\tLD\t" << *Load << "\t"  << *Load->getType() << "\t\t" << "\n";
-                  getTypeData(LoadType);
-                }
-            }
-          }
+    // Runs on a worker thread. DominatorTree and LoopInfo are private to the
+    // Function; ScalarEvolution and AssumptionCache register value handles in
+    // the shared LLVMContext, so they are created and destroyed under the lock.
+    // The feature walk, BranchProbabilityInfo and BlockFrequencyInfo only read
+    // the IR and its metadata, and the Cache and the struct layouts of the
+    // DataLayout are only read here.
+    // In the deep tier Key was computed before the dependences were collected.
+    static void analyzeFunction(Function &F, const TargetLibraryInfoImpl &TLII, SignatureRegistry &Registry,
+                                TypeSizeCache &Types, const SignatureCache &Cache, std::mutex &ContextLock,
+                                const LoopDependenceMap *Dependences, FunctionRecord &Record, uint64_t &Key) {
+
+      if (!CacheFilename.empty()) {
+        if (Level < FSIG_DEEP)
+          Key = FunctionHasher().hash(F, Level, Registry, Latencies.hash());
+
+        if (const FunctionRecord *Cached = Cache.lookup(Key)) {
+          Record = *Cached;
+          FunctionSignatureAnalyzer(Registry, Types, &ContextLock).relink(F, Record);
+          return;
+        }
+      }
 
-          // Store Info
-          if(StoreInst *Store = dyn_cast<StoreInst>(&*BI)) {
+      if (Level < FSIG_STANDARD) {
+        FunctionSignatureAnalyzer(Registry, Types, &ContextLock).analyze(F, nullptr, nullptr, nullptr, Record);
+        return;
+      }
 
-            // errs() << "Store\n"; 
-            errs() << "\tST\t" << *Store << "\t"  << *Store->getType() << "\t\t" << "\n";
+      DominatorTree DT(F);
+      LoopInfo LI(DT);
+      BranchProbabilityInfo BPI;
+      TargetLibraryInfo TLI(TLII);
+      std::unique_ptr<AssumptionCache> AC;
+      std::unique_ptr<ScalarEvolution> SE;
+
+      {
+        std::lock_guard<std::mutex> Lock(ContextLock);
+        AC.reset(new AssumptionCache(F));
+        SE.reset(new ScalarEvolution(F, TLI, *AC, DT, LI));
+      }
 
-            llvm::Type *StoreType = Store->getType();
-            // llvm::Type *Ptr_StoreType = NULL;
+      BPI.calculate(F, LI);
+      BlockFrequencyInfo BFI(F, BPI, LI);
 
-            if ( StoreType->isPointerTy()) {
-              llvm::Type *Ptr_StoreType = StoreType->getPointerElementType();
+      FunctionSignatureAnalyzer Analyzer(Registry, Types, &ContextLock);
 
-               if (Ptr_StoreType->isStructTy() || Ptr_StoreType->isArrayTy() || Ptr_StoreType->isVectorTy()) {
-                  errs() << "\t" << *Store << "\t"  << *Store->getType() << "\t\t" << "\n";
-                  getTypeData(StoreType);
-                }
-            }
-          }
+      Analyzer.setDependences(Dependences);
+      Analyzer.setLatencies(&Latencies);
+      Analyzer.analyze(F, &LI, SE.get(), &BFI, Record, Level);
 
-          NumberOfInstructions++;
-        } // End of BB For
-      } // End of Function For
-      errs() << "   ----------------------------------------------" << '\n';
-      errs() << " Number of Instructions : " << NumberOfInstructions << "\n";
-      errs() << "   ----------------------------------------------" << '\n';
+      std::lock_guard<std::mutex> Lock(ContextLock);
+      SE.reset();
+      AC.reset();
     }
 
     virtual void getAnalysisUsage(AnalysisUsage& AU) const override {
-              
-        AU.addRequired<LoopInfoWrapperPass>();
-        AU.addRequiredTransitive<ScalarEvolutionWrapperPass>();
-        AU.addRequired<DependenceAnalysis>();    
-        // AU.addRequired<BlockFrequencyInfoWrapperPass>();
+        if (Level >= FSIG_DEEP)
+          AU.addRequired<LoopDependencePass>();
         AU.setPreservesAll();
-    } 
+    }
   };
 }
 
 char FunctionSignature::ID = 0;
 static RegisterPass<FunctionSignature> X("FunctionSignature", "Identify Loops within Functions");
+
+char FunctionSignatureParallel::ID = 0;
+static RegisterPass<FunctionSignatureParallel> Y("FunctionSignatureParallel", "Identify Loops within Functions on a thread pool");
+
+char LoopDependencePass::ID = 0;
+static RegisterPass<LoopDependencePass> Z("fsig-loop-dependences", "Loop-carried memory dependences of FunctionSignature",
+                                          false, true);
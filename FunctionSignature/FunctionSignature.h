@@ -15,15 +15,291 @@
 //
 //===----------------------------------------------------------------------===//
 
+#ifndef FUNCTION_SIGNATURE_H
+#define FUNCTION_SIGNATURE_H
 
-  int find_function(std::vector<Function *> list, Function *F) {
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/IR/Constants.h"
+#include "llvm/IR/DataLayout.h"
+#include "llvm/IR/DerivedTypes.h"
+#include "llvm/IR/Function.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/IR/Metadata.h"
+#include "llvm/IR/Module.h"
+#include "llvm/IR/Operator.h"
+#include "llvm/IR/TypeFinder.h"
+#include "llvm/Support/raw_ostream.h"
+#include <algorithm>
+#include <mutex>
+#include <string>
 
-    for (unsigned i = 0; i < list.size(); i++)
-      if (list[i] == F)
-        return i;
-    
-    return -1;
-  }
+namespace llvm {
+
+  // Registry of the Functions seen by the pass, keyed by pointer so that a
+  // lookup is O(1) instead of a scan over a global list. The Loops of the
+  // Function being analyzed are kept by FunctionSignatureAnalyzer.
+  //
+  class SignatureRegistry {
+
+    DenseMap<Function *, unsigned int> Functions; // Number of instructions per Function.
+
+  public:
+
+    static unsigned int countInstructions(Function *F) {
+
+      unsigned int NumberOfLLVMInstructions = 0;
+
+      for(Function::iterator BB = F->begin(), E = F->end(); BB != E; ++BB)
+        NumberOfLLVMInstructions += BB->size();
+
+      return NumberOfLLVMInstructions;
+    }
+
+    // (Re)count the instructions of F. A Function visited again only updates
+    // its entry.
+    unsigned int addFunction(Function *F) {
+      return Functions[F] = countInstructions(F);
+    }
+
+    void setNumberOfInstructions(Function *F, unsigned int NumberOfInstructions) {
+      Functions[F] = NumberOfInstructions;
+    }
+
+    bool hasFunction(Function *F) const {
+      return Functions.count(F);
+    }
+
+    // Number of instructions of F. Callees that the pass has not visited yet
+    // are counted on first use and memoized.
+    unsigned int getNumberOfInstructions(Function *F) {
+
+      DenseMap<Function *, unsigned int>::iterator It = Functions.find(F);
+
+      if (It != Functions.end())
+        return It->second;
+
+      return addFunction(F);
+    }
+  };
+
+
+  // Size and layout summary of a Type. Pointers are followed to the data they
+  // point to, as in the P[...] records.
+  //
+  struct TypeSummary {
+    uint64_t SizeInBits; // DataLayout size, padding included.
+    uint64_t PaddingInBits; // Struct padding, nested structs and arrays included.
+    unsigned int Alignment; // ABI alignment in bytes.
+    std::string Walk; // Rendering of the type walk, as in the P[...] records.
+
+    TypeSummary() : SizeInBits(0), PaddingInBits(0), Alignment(0) {}
+  };
+
+  // Per-Module cache of TypeSummary keyed by Type *, computed with the
+  // DataLayout of the Module. A struct shared by many Functions is walked once,
+  // and the walk of a recursive struct stops at the struct it started from.
+  // The cache is shared by the workers of FunctionSignatureParallel, which
+  // lay out the structs of the Module up front with layoutStructs().
+  //
+  class TypeSizeCache {
+
+    const DataLayout &DL;
+    DenseMap<Type *, TypeSummary> Summaries;
+    DenseMap<Type *, uint64_t> Paddings;
+    DenseMap<StructType *, unsigned int> InProgress; // Structs on the current walk, by depth in it.
+    std::mutex Lock; // Guards the maps.
+    unsigned int NumberOfWalks; // Types summarized, for -stats.
+    unsigned int NumberOfHits; // Types found in the cache.
+
+    // START
+    // IMPORT FROM ACCELSEEKER FUNCTIONS
+    //
+    static bool structNameIsValid(llvm::Type *type) {
+
+      if (type->getStructName() == "struct._IO_marker")
+        return 0;
+      if (type->getStructName() == "struct._IO_FILE")
+        return 0;
+
+
+      return 1;
+    }
+
+    // Padding bits of a value of type Ty. It only recurses through by-value
+    // members, which cannot form a cycle.
+    uint64_t getPaddingInBits(Type *Ty) {
+
+      if (!Ty->isSized() || !(Ty->isStructTy() || Ty->isArrayTy()))
+        return 0;
+
+      DenseMap<Type *, uint64_t>::iterator It = Paddings.find(Ty);
+
+      if (It != Paddings.end())
+        return It->second;
+
+      uint64_t Payload = 0;
+
+      if (StructType *ST = dyn_cast<StructType>(Ty)) {
+        for (unsigned i = 0; i < ST->getNumElements(); i++) {
+          Type *Element = ST->getElementType(i);
+          Payload += DL.getTypeSizeInBits(Element) - getPaddingInBits(Element);
+        }
+      }
+      else {
+        Type *Element = Ty->getArrayElementType();
+        Payload = Ty->getArrayNumElements() *
+          (DL.getTypeSizeInBits(Element) - getPaddingInBits(Element));
+      }
+
+      return Paddings[Ty] = DL.getTypeAllocSizeInBits(Ty) - Payload;
+    }
+
+    // Gather the data of the Array type.
+    //
+    void walkArray(llvm::Type *type, raw_ostream &OS) {
+
+      while (type->isArrayTy()) {
+
+        llvm::Type *array_type    = type->getArrayElementType();
+        int NumberOfArrayElements     = type->getArrayNumElements();
+        int SizeOfElement           = array_type->getPrimitiveSizeInBits();
+
+        OS << "\t A[name:"
+          << " NA"
+          <<"; type:" << *array_type
+          << "; n_bit:" << SizeOfElement << "; size:"  << NumberOfArrayElements << ";];" ;
+
+        if (SizeOfElement)
+          return;
+        else
+          type = array_type;
+      }
+    }
+
+    // Returns the depth of the outermost struct still being walked that the
+    // walk of type reached, or FSIG_WALK_CLOSED. Such a summary depends on
+    // where the walk started and is not cached; the one of that struct is,
+    // once its own walk is over.
+    static const unsigned int FSIG_WALK_CLOSED = ~0U;
+
+    unsigned int summarize(Type *type, TypeSummary &Summary) {
+
+      DenseMap<Type *, TypeSummary>::iterator It = Summaries.find(type);
+
+      if (It != Summaries.end()) {
+        Summary = It->second;
+        return FSIG_WALK_CLOSED;
+      }
+
+      unsigned int Open = FSIG_WALK_CLOSED;
+      raw_string_ostream OS(Summary.Walk);
+
+      if ( type->isPointerTy()) {
+
+        TypeSummary Pointee;
+        Open = summarize(type->getPointerElementType(), Pointee);
+
+        OS << "*" << Pointee.Walk;
+        Summary.SizeInBits = Pointee.SizeInBits;
+        Summary.PaddingInBits = Pointee.PaddingInBits;
+        Summary.Alignment = Pointee.Alignment;
+      }
+
+      // Struct Case
+      else if (StructType *struct_type = dyn_cast<StructType>(type)) {
+
+        OS << " S["  << type->getStructName() << ";";
+
+        unsigned int Depth = InProgress.size();
+        std::pair<DenseMap<StructType *, unsigned int>::iterator, bool> Walk =
+          InProgress.insert(std::make_pair(struct_type, Depth));
+
+        if (!Walk.second) {
+          OS << " ...];"; // Recursive struct, already being walked.
+          Open = Walk.first->second;
+        }
+        else {
+          for  (llvm::StructType::element_iterator  EI= struct_type->element_begin(), EE = struct_type->element_end(); EI != EE; ++EI) {
+
+            OS << "\n\t\taddr:" << EI << ";";
+
+            if (structNameIsValid(type)) {
+              TypeSummary Element;
+              Open = std::min(Open, summarize(*EI, Element));
+              OS << Element.Walk;
+            }
+          }
+
+          OS << "];";
+          InProgress.erase(struct_type);
+
+          // Only the walks nested in this one reached it.
+          if (Open >= Depth)
+            Open = FSIG_WALK_CLOSED;
+        }
+      }
+
+      // Scalar Case
+      else if ( type->getPrimitiveSizeInBits()) {
+        OS << "i" << type->getPrimitiveSizeInBits();
+      }
+
+      // Array Case
+      else if(type->isArrayTy()) {
+        walkArray(type, OS);
+      }
+
+      if (!type->isPointerTy() && type->isSized()) {
+        Summary.SizeInBits = (type->isStructTy() || type->isArrayTy()) ?
+          DL.getTypeAllocSizeInBits(type) : DL.getTypeSizeInBits(type);
+        Summary.PaddingInBits = getPaddingInBits(type);
+        Summary.Alignment = DL.getABITypeAlignment(type);
+      }
+
+      OS.flush();
+
+      if (Open == FSIG_WALK_CLOSED)
+        Summaries[type] = Summary;
+
+      return Open;
+    }
+
+  public:
+
+    explicit TypeSizeCache(const DataLayout &DL) : DL(DL), NumberOfWalks(0), NumberOfHits(0) {}
+
+    TypeSummary get(Type *Ty) {
+
+      std::lock_guard<std::mutex> Guard(Lock);
+      TypeSummary Summary;
+
+      if (Summaries.count(Ty))
+        NumberOfHits++;
+      else
+        NumberOfWalks++;
+
+      summarize(Ty, Summary);
+
+      return Summary;
+    }
+
+    // DataLayout fills its StructLayout cache, and a struct its sized flag, on
+    // first use, without a lock. Every struct M uses is laid out here, before
+    // any worker starts, so that the workers only read them: the feature
+    // walk, SCEV and this cache all reach the struct layouts.
+    void layoutStructs(const Module &M) {
+
+      TypeFinder StructTypes;
+      StructTypes.run(M, false);
+
+      for (TypeFinder::iterator It = StructTypes.begin(), E = StructTypes.end(); It != E; ++It)
+        if ((*It)->isSized())
+          DL.getStructLayout(*It);
+    }
+
+    unsigned int getNumberOfWalks() const { return NumberOfWalks; }
+    unsigned int getNumberOfHits() const { return NumberOfHits; }
+  };
 
 
     int getEntryCount(Function *F) {
@@ -34,7 +310,8 @@
 
         MDNode *node = F->getMetadata("prof");
 
-        if (MDString::classof(node->getOperand(0))) {
+        // Debug info alone attaches metadata without a !prof node.
+        if (node && node->getNumOperands() > 1 && MDString::classof(node->getOperand(0))) {
           auto mds = cast<MDString>(node->getOperand(0));
           std::string metadata_str = mds->getString();
 
@@ -104,3 +381,7 @@ bool isInductionVariable(Value *DependencyVar) {
 
   return LoopCarriedDep;
 }
+
+} // End of namespace llvm
+
+#endif
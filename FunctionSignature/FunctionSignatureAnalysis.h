@@ -0,0 +1,147 @@
+//===-------------------- FunctionSignatureAnalysis.h ---------------------===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the Università della Svizzera italiana (USI)
+// Open Source License.
+//
+// Author         : Georgios Zacharopoulos
+// Date Started   : April, 2019
+//
+//===----------------------------------------------------------------------===//
+//
+// New pass manager port of FunctionSignature: an analysis that returns a
+// FunctionSignatureResult, cached by the FunctionAnalysisManager, and a
+// separate printer pass.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef FUNCTION_SIGNATURE_ANALYSIS_H
+#define FUNCTION_SIGNATURE_ANALYSIS_H
+
+#include "llvm/Analysis/BlockFrequencyInfo.h"
+#include "llvm/Analysis/BranchProbabilityInfo.h"
+#include "llvm/Analysis/LoopInfo.h"
+#include "llvm/Analysis/ScalarEvolution.h"
+#include "llvm/IR/Function.h"
+#include "llvm/IR/Module.h"
+#include "llvm/IR/PassManager.h"
+#include "FunctionSignature.h"
+#include "FunctionSignatureOutput.h"
+#include "FunctionSignatureAnalyzer.h"
+#include <memory>
+
+namespace llvm {
+
+  // Signature of one Function. The result stays cached until a pass that
+  // does not preserve FunctionSignatureAnalysis runs on the Function.
+  //
+  class FunctionSignatureResult {
+
+    FunctionRecord Record;
+
+  public:
+
+    explicit FunctionSignatureResult(FunctionRecord Record) : Record(std::move(Record)) {}
+
+    const FunctionRecord &getRecord() const { return Record; }
+
+    void print(raw_ostream &OS, SignatureFormat Format = FSIG_TEXT) const {
+
+      if (Format == FSIG_JSON)
+        writeJSONRecord(OS, Record);
+      else
+        writeTextRecord(OS, Record);
+    }
+  };
+
+  // Analysis pass. Copies share the Registry and the TypeSizeCache, which
+  // are created on first use when the analysis is default-constructed. The
+  // deep tier reports memory dependences only when given the LoopDependenceMap
+  // of the Function, which its owner refreshes before asking for a result.
+  // Pipelines are estimated with the default latencies unless given a table.
+  //
+  class FunctionSignatureAnalysis {
+
+    std::shared_ptr<SignatureRegistry> Registry;
+    std::shared_ptr<TypeSizeCache> Types;
+    AnalysisLevel Level;
+    const LoopDependenceMap *Dependences;
+    const LatencyTable *Latencies;
+
+  public:
+
+    typedef FunctionSignatureResult Result;
+
+    // Inline, so that the plugin and the fsig driver share a single ID.
+    static void *ID() {
+      static char PassID;
+      return (void *)&PassID;
+    }
+
+    static StringRef name() { return "FunctionSignatureAnalysis"; }
+
+    explicit FunctionSignatureAnalysis(AnalysisLevel Level = FSIG_STANDARD)
+      : Registry(std::make_shared<SignatureRegistry>()), Level(Level), Dependences(nullptr), Latencies(nullptr) {}
+
+    FunctionSignatureAnalysis(std::shared_ptr<SignatureRegistry> Registry, std::shared_ptr<TypeSizeCache> Types,
+                              AnalysisLevel Level = FSIG_STANDARD, const LoopDependenceMap *Dependences = nullptr,
+                              const LatencyTable *Latencies = nullptr)
+      : Registry(Registry), Types(Types), Level(Level), Dependences(Dependences), Latencies(Latencies) {}
+
+    Result run(Function &F, AnalysisManager<Function> *AM) {
+
+      FunctionRecord Record;
+
+      if (!Types)
+        Types = std::make_shared<TypeSizeCache>(F.getParent()->getDataLayout());
+
+      if (Level < FSIG_STANDARD)
+        FunctionSignatureAnalyzer(*Registry, *Types).analyze(F, nullptr, nullptr, nullptr, Record, Level);
+      else {
+        LoopInfo &LI = AM->getResult<LoopAnalysis>(F);
+        ScalarEvolution &SE = AM->getResult<ScalarEvolutionAnalysis>(F);
+        BranchProbabilityInfo BPI;
+
+        // BlockFrequencyInfo has no new pass manager analysis yet.
+        BPI.calculate(F, LI);
+        BlockFrequencyInfo BFI(F, BPI, LI);
+
+        FunctionSignatureAnalyzer Analyzer(*Registry, *Types);
+
+        Analyzer.setDependences(Dependences);
+        Analyzer.setLatencies(Latencies);
+        Analyzer.analyze(F, &LI, &SE, &BFI, Record, Level);
+      }
+
+      Registry->setNumberOfInstructions(&F, Record.Features.NumberOfInstructions);
+
+      return Result(std::move(Record));
+    }
+  };
+
+  // Printer pass: writes the cached result of every Function it runs on.
+  //
+  class FunctionSignaturePrinterPass {
+
+    raw_ostream &OS;
+    SignatureFormat Format;
+
+  public:
+
+    explicit FunctionSignaturePrinterPass(raw_ostream &OS, SignatureFormat Format = FSIG_TEXT)
+      : OS(OS), Format(Format) {}
+
+    static StringRef name() { return "FunctionSignaturePrinterPass"; }
+
+    PreservedAnalyses run(Function &F, AnalysisManager<Function> *AM) {
+
+      AM->getResult<FunctionSignatureAnalysis>(F).print(OS, Format);
+
+      return PreservedAnalyses::all();
+    }
+  };
+
+} // End of namespace llvm
+
+#endif
@@ -0,0 +1,607 @@
+//===-------------------- FunctionSignatureAnalyzer.h ---------------------===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the Università della Svizzera italiana (USI)
+// Open Source License.
+//
+// Author         : Georgios Zacharopoulos
+// Date Started   : April, 2019
+//
+//===----------------------------------------------------------------------===//
+//
+// Analysis of a single Function into a self-contained FunctionRecord. It is
+// shared by the FunctionSignature pass and its parallel module-level driver.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef FUNCTION_SIGNATURE_ANALYZER_H
+#define FUNCTION_SIGNATURE_ANALYZER_H
+
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/Analysis/BlockFrequencyInfo.h"
+#include "llvm/Analysis/LoopInfo.h"
+#include "llvm/Analysis/ScalarEvolution.h"
+#include "llvm/Analysis/ScalarEvolutionExpressions.h"
+#include "llvm/IR/DebugInfoMetadata.h"
+#include "llvm/IR/DataLayout.h"
+#include "llvm/IR/DerivedTypes.h"
+#include "llvm/IR/Function.h"
+#include "llvm/IR/InstVisitor.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/Support/Timer.h"
+#include "llvm/Support/raw_ostream.h"
+#include "FunctionSignature.h"
+#include "FunctionSignatureDependence.h"
+#include "FunctionSignatureFootprint.h"
+#include "FunctionSignatureOutput.h"
+#include "FunctionSignaturePipeline.h"
+#include "FunctionSignatureSketch.h"
+#include <algorithm>
+#include <mutex>
+
+namespace llvm {
+
+  // Analysis tiers. Each one only needs the analyses it uses:
+  //   cheap    : instruction counts and signatures, no analysis at all.
+  //   standard : + loops and SCEV (LoopInfo, ScalarEvolution).
+  //   deep     : + dependence distances and memory access patterns.
+  //
+  enum AnalysisLevel { FSIG_CHEAP, FSIG_STANDARD, FSIG_DEEP };
+
+  // Single walk over a basic block. Fills the feature counters of the block
+  // and the successors of its conditional branches and, when asked, its R, W
+  // and C records, and appends its loads and stores to the accesses of its
+  // innermost Loop. The sketch accumulates over all the walked blocks.
+  //
+  class FeatureExtractor : public InstVisitor<FeatureExtractor> {
+
+    SignatureRegistry &Registry;
+    const DataLayout &DL;
+    BlockRecord *Block;
+    std::vector<MemoryAccess> *Memory;
+    bool RecordAccessesAndCalls;
+    SketchBuilder Sketch;
+
+    static bool isIgnoredCall(StringRef CallName) {
+      return CallName == "llvm.dbg.value" || CallName == "llvm.lifetime.start" ||
+             CallName == "llvm.lifetime.end";
+    }
+
+  public:
+
+    // Loads, and stores that are not to local variables.
+    static bool isReportedAccess(Instruction &I) {
+      return isa<LoadInst>(&I) || (isa<StoreInst>(&I) && !isa<AllocaInst>(I.getOperand(1)));
+    }
+
+    FeatureExtractor(SignatureRegistry &Registry, const DataLayout &DL)
+      : Registry(Registry), DL(DL), Block(nullptr), Memory(nullptr), RecordAccessesAndCalls(false) {}
+
+    void walk(BasicBlock &BB, BlockRecord &Record, bool RecordBody, std::vector<MemoryAccess> &Accesses) {
+
+      Block = &Record;
+      Memory = &Accesses;
+      RecordAccessesAndCalls = RecordBody;
+      Sketch.beginBlock();
+
+      for(BasicBlock::iterator BI = BB.begin(), BE = BB.end(); BI != BE; ++BI) {
+        Record.Features.NumberOfInstructions++;
+        Sketch.add(*BI);
+        visit(*BI);
+      }
+    }
+
+    void getSketch(std::vector<uint32_t> &Result) const { Sketch.getSketch(Result); }
+
+    void visitLoadInst(LoadInst &Load) {
+
+      uint64_t Size = DL.getTypeStoreSize(Load.getType());
+      MemoryAccess Access = { Load.getPointerOperand(), Size, false };
+
+      Block->Features.Loads++;
+      Block->Features.BytesLoaded += Size;
+      Memory->push_back(Access);
+
+      if (RecordAccessesAndCalls) {
+        AccessRecord Read = { false, &Load, Load.getOperand(0)->getName(), Size };
+        Block->Accesses.push_back(Read);
+      }
+    }
+
+    void visitStoreInst(StoreInst &Store) {
+
+      uint64_t Size = DL.getTypeStoreSize(Store.getValueOperand()->getType());
+      MemoryAccess Access = { Store.getPointerOperand(), Size, true };
+
+      Block->Features.Stores++;
+      Block->Features.BytesStored += Size;
+      Memory->push_back(Access);
+
+      // Stores to local variables are not reported.
+      if (RecordAccessesAndCalls && !isa<AllocaInst>(Store.getOperand(1))) {
+        AccessRecord Write = { true, &Store, Store.getOperand(1)->getName(), Size };
+        Block->Accesses.push_back(Write);
+      }
+    }
+
+    void visitCallInst(CallInst &CI) {
+
+      Function *Callee = CI.getCalledFunction();
+
+      if (Callee && isIgnoredCall(Callee->getName())) {
+        Block->Features.OtherOps++;
+        return;
+      }
+
+      Block->Features.Calls++;
+
+      // Indirect calls have no callee to report.
+      if (RecordAccessesAndCalls && Callee) {
+        CallRecord Call;
+        Call.Name = Callee->getName();
+        Call.NumberOfInstructions = Registry.getNumberOfInstructions(Callee);
+        Block->Calls.push_back(Call);
+      }
+    }
+
+    // If-Else Analsyis (Branch Instructions Analysis)
+    //
+    void visitBranchInst(BranchInst &BRI) {
+
+      Block->Features.ControlOps++;
+
+      if (BRI.isConditional()) {
+        Block->Features.CondBranches++;
+
+        for (unsigned int i=0; i< BRI.getNumSuccessors(); i++)
+          Block->Branches.push_back(BRI.getSuccessor(i)->getName());
+      }
+    }
+
+    void visitBinaryOperator(BinaryOperator &I) {
+
+      if (I.getType()->isFPOrFPVectorTy())
+        Block->Features.FloatOps++;
+      else
+        Block->Features.IntOps++;
+    }
+
+    void visitCmpInst(CmpInst &I)                     { Block->Features.Compares++; }
+    void visitCastInst(CastInst &I)                   { Block->Features.Casts++; }
+    void visitGetElementPtrInst(GetElementPtrInst &I) { Block->Features.AddressOps++; }
+    void visitAllocaInst(AllocaInst &I)               { Block->Features.AddressOps++; }
+    void visitTerminatorInst(TerminatorInst &I)       { Block->Features.ControlOps++; }
+    void visitInstruction(Instruction &I)             { Block->Features.OtherOps++; }
+  };
+
+  // Phase timers, reported with -time-passes. A Timer cannot run on two
+  // threads at once, so the parallel driver does not use them.
+  //
+  struct SignatureTimers {
+    TimerGroup Group;
+    Timer Census; // Per-block instruction walk.
+    Timer Loops; // Access sizes and patterns, loop summaries and SCEV.
+    Timer Types; // Argument types.
+    Timer Output; // Inclusive costs and records.
+
+    SignatureTimers()
+      : Group("FunctionSignature"), Census("Instruction census", Group), Loops("Loops and SCEV", Group),
+        Types("Type analysis", Group), Output("Output", Group) {}
+  };
+
+  // Finds a value loaded inside a Loop among the operands of a SCEV, as in the
+  // address of A[B[i]].
+  //
+  struct LoadInLoopFinder {
+    const Loop *L;
+    bool Found;
+
+    LoadInLoopFinder(const Loop *L) : L(L), Found(false) {}
+
+    bool follow(const SCEV *S) {
+
+      if (const SCEVUnknown *Unknown = dyn_cast<SCEVUnknown>(S))
+        if (LoadInst *Load = dyn_cast<LoadInst>(Unknown->getValue()))
+          Found |= L->contains(Load);
+
+      return !Found;
+    }
+
+    bool isDone() const { return Found; }
+  };
+
+  class FunctionSignatureAnalyzer {
+
+    SignatureRegistry &Registry; // Instruction counts of all Functions, shared.
+    TypeSizeCache &Types; // Type sizes of the Module, shared.
+    std::mutex *ContextLock; // Held around SCEV queries when running in parallel.
+    DenseMap<Loop *, unsigned int> Loops; // Block that carries the L[...] record of each Loop.
+    DenseMap<const Loop *, unsigned int> TripCounts; // Constant trip count of each Loop, 0 when unknown.
+    DenseMap<std::pair<Value *, Loop *>, std::pair<AccessPattern, int64_t> > Patterns; // Per pointer, with the deep tier.
+    const DataLayout *DL;
+    bool ClassifyAccesses;
+    const LoopDependenceMap *Dependences; // Of the Function being analyzed, in the deep tier.
+    const LatencyTable *Latencies; // Null for the default latencies.
+    SignatureTimers *Timers; // Null unless -time-passes.
+
+    // ScalarEvolution uniques constants and value handles in the LLVMContext,
+    // which is shared by all the Functions of the Module and is not
+    // thread-safe.
+    std::unique_lock<std::mutex> lockContext() {
+
+      if (ContextLock)
+        return std::unique_lock<std::mutex>(*ContextLock);
+
+      return std::unique_lock<std::mutex>();
+    }
+
+  public:
+
+    FunctionSignatureAnalyzer(SignatureRegistry &Registry, TypeSizeCache &Types, std::mutex *ContextLock = nullptr)
+      : Registry(Registry), Types(Types), ContextLock(ContextLock), DL(nullptr), ClassifyAccesses(false),
+        Dependences(nullptr), Latencies(nullptr), Timers(nullptr) {}
+
+    void setTimers(SignatureTimers *T) { Timers = T; }
+
+    // Memory dependences of the Loops of the next Function, from a
+    // LoopDependencePass. Only the deep tier reports them.
+    void setDependences(const LoopDependenceMap *D) { Dependences = D; }
+
+    // Latencies and ports the initiation intervals of the innermost Loops are
+    // estimated with, shared by all the Functions.
+    void setLatencies(const LatencyTable *L) { Latencies = L; }
+
+    // Fill the record of F. The instruction counts of its callees are read
+    // from the Registry. LI, SE and BFI are null in the cheap tier, and every
+    // block is then reported as if it was outside loops, without dynamic
+    // counts.
+    //
+    void analyze(Function &F, LoopInfo *LI, ScalarEvolution *SE, BlockFrequencyInfo *BFI,
+                 FunctionRecord &Record, AnalysisLevel Level = FSIG_STANDARD) {
+
+      // Loop and value pointers are only valid for the Function they belong to.
+      Loops.clear();
+      TripCounts.clear();
+      Patterns.clear();
+      DL = &F.getParent()->getDataLayout();
+      ClassifyAccesses = Level >= FSIG_DEEP && SE;
+
+      Record.Name = F.getName();
+      Record.IsLocal = F.hasLocalLinkage();
+      Record.CallFreq = getEntryCount(&F);
+
+      getFunctionSignature(&F, Record);
+
+      {
+        TimeRegion Region(Timers ? &Timers->Types : nullptr);
+        getInputFunction(&F, Record);
+      }
+
+      getLoadsStoresLoopsOfFunction(&F, LI, SE, BFI, Record);
+    }
+
+    // Refresh the parts of a cached record that point into this run: the
+    // P[...] records and the addr: fields of the R and W records. The walk
+    // follows the filter of FeatureExtractor.
+    //
+    void relink(Function &F, FunctionRecord &Record) {
+
+      Record.Params.clear();
+      getInputFunction(&F, Record);
+
+      unsigned int b = 0;
+
+      for(Function::iterator BB = F.begin(), E = F.end(); BB != E && b < Record.Blocks.size(); ++BB, ++b) {
+
+        std::vector<AccessRecord> &Accesses = Record.Blocks[b].Accesses;
+        unsigned int i = 0;
+
+        for(BasicBlock::iterator BI = BB->begin(), BE = BB->end(); BI != BE && i < Accesses.size(); ++BI) {
+
+          if (FeatureExtractor::isReportedAccess(*BI))
+            Accesses[i++].Addr = &*BI;
+        }
+      }
+    }
+
+    // Loops Identifier of a given function. (if any loops)
+    //
+    void getLoadsStoresLoopsOfFunction (Function *F, LoopInfo *LI, ScalarEvolution *SE, BlockFrequencyInfo *BFI,
+                                        FunctionRecord &Record) {
+
+      FeatureExtractor Extractor(Registry, *DL);
+      DenseMap<Loop *, LoopRecord> Summaries; // Blocks whose innermost Loop it is, then nested Loops.
+      DenseMap<Loop *, std::vector<MemoryAccess> > Memory; // Likewise, null outside every Loop.
+      double EntryFrequency = BFI ? BFI->getEntryFreq() : 0;
+      double Calls = std::max(Record.CallFreq, 1); // Dynamic counts per call without a profile.
+
+      // Without an entry count the block frequencies are only the static
+      // heuristics of BlockFrequencyInfo.
+      Record.HasDynamicCounts = BFI && EntryFrequency;
+      Record.IsProfiled = Record.HasDynamicCounts && F->getEntryCount().hasValue();
+
+      for(Function::iterator BB = F->begin(), E = F->end(); BB != E; ++BB) {
+
+        BasicBlock *CurrentBlock = &*BB;
+        Loop *L = (LI && SE) ? LI->getLoopFor(CurrentBlock) : nullptr;
+
+        Record.Blocks.push_back(BlockRecord());
+        BlockRecord &Block = Record.Blocks.back();
+        Block.Name = CurrentBlock->getName();
+
+        {
+          TimeRegion Region(Timers ? &Timers->Census : nullptr);
+          Extractor.walk(*CurrentBlock, Block, true, Memory[L]);
+          Record.Features += Block.Features;
+        }
+
+        TimeRegion Region(Timers ? &Timers->Loops : nullptr);
+
+        if (ClassifyAccesses)
+          classifyAccesses(Block, L, SE);
+
+        if (Record.HasDynamicCounts) {
+          Block.Frequency = BFI->getBlockFreq(CurrentBlock).getFrequency() / EntryFrequency;
+          Block.Dynamic.Instructions = Block.Features.NumberOfInstructions * Block.Frequency * Calls + 0.5;
+          Block.Dynamic.Loads = Block.Features.Loads * Block.Frequency * Calls + 0.5;
+          Block.Dynamic.Stores = Block.Features.Stores * Block.Frequency * Calls + 0.5;
+          Block.Dynamic.ArithmeticOps = Block.Features.getArithmeticOps() * Block.Frequency * Calls + 0.5;
+          Block.Dynamic.BytesLoaded = Block.Features.BytesLoaded * Block.Frequency * Calls + 0.5;
+          Block.Dynamic.BytesStored = Block.Features.BytesStored * Block.Frequency * Calls + 0.5;
+          Record.Dynamic += Block.Dynamic;
+        }
+
+        if (!L)
+          continue;
+
+        // The first block visited in each Loop carries its L[...] record.
+        if (Loops.insert(std::make_pair(L, Record.Blocks.size() - 1)).second)
+          Summaries[L].LoopCarriedDeps = getLoopCarriedDependencies(CurrentBlock);
+
+        Summaries[L].NumberOfBlocks++;
+        Summaries[L].Features += Block.Features;
+        Summaries[L].BytesPerIteration += Block.Features.BytesLoaded + Block.Features.BytesStored;
+        Summaries[L].Dynamic += Block.Dynamic;
+      }
+
+      Extractor.getSketch(Record.Sketch);
+
+      // Without SE every access is sized from its array type, or counted once.
+      {
+        TimeRegion Region(Timers ? &Timers->Loops : nullptr);
+        std::unique_lock<std::mutex> Lock = lockContext();
+        FootprintEstimator Footprint(SE, TripCounts, *DL, nullptr);
+        const std::vector<MemoryAccess> &Accesses = Memory[nullptr];
+
+        for (unsigned i = 0; i < Accesses.size(); i++)
+          Footprint.add(Accesses[i]);
+
+        if (!Loops.empty())
+          for (LoopInfo::iterator L = LI->begin(), E = LI->end(); L != E; ++L)
+            summarizeLoop(*L, SE, Summaries, Memory, Footprint);
+
+        Record.Footprint = Footprint.get();
+      }
+
+      if (Loops.empty())
+        return;
+
+      if (Dependences && ClassifyAccesses)
+        for (DenseMap<Loop *, unsigned int>::iterator It = Loops.begin(), E = Loops.end(); It != E; ++It) {
+
+          LoopDependenceMap::const_iterator Deps = Dependences->find(It->first->getHeader());
+
+          if (Deps == Dependences->end())
+            continue;
+
+          // The loop is only parallel when no dependence is carried at all.
+          Summaries[It->first].Dependences = Deps->second;
+          Summaries[It->first].LoopCarriedDeps += Deps->second.Carried + Deps->second.Unknown;
+        }
+
+      {
+        TimeRegion Region(Timers ? &Timers->Loops : nullptr);
+        static const LatencyTable DefaultLatencies;
+        PipelineEstimator Estimator(Latencies ? *Latencies : DefaultLatencies);
+
+        for (DenseMap<Loop *, unsigned int>::iterator It = Loops.begin(), E = Loops.end(); It != E; ++It)
+          if (It->first->empty())
+            Summaries[It->first].Pipeline = Estimator.estimate(It->first, LI, Summaries[It->first]);
+      }
+
+      for (DenseMap<Loop *, unsigned int>::iterator It = Loops.begin(), E = Loops.end(); It != E; ++It) {
+        BlockRecord &Block = Record.Blocks[It->second];
+
+        Block.HasLoop = true;
+        Block.Loop = Summaries[It->first];
+      }
+    }
+
+    // Add the nested Loops of L to its summary, bottom-up, so that every block
+    // is walked once, and query SCEV once for the trip count of L, into
+    // TripCounts. A nested Loop moves its bytes once per iteration; one with
+    // an unknown trip count is counted once. The footprint of L, from its own
+    // accesses and those of its nested Loops, is then added to the one of the
+    // Loop, or Function, around it.
+    //
+    void summarizeLoop(Loop *L, ScalarEvolution *SE, DenseMap<Loop *, LoopRecord> &Summaries,
+                       DenseMap<Loop *, std::vector<MemoryAccess> > &Memory, FootprintEstimator &Parent) {
+
+      LoopRecord Nested;
+      unsigned int TripCount = TripCounts[L] = SE->getSmallConstantTripCount(L);
+      FootprintEstimator Footprint(SE, TripCounts, *DL, L);
+      const std::vector<MemoryAccess> &Accesses = Memory[L];
+
+      for (unsigned i = 0; i < Accesses.size(); i++)
+        Footprint.add(Accesses[i]);
+
+      for (Loop::iterator Sub = L->begin(), E = L->end(); Sub != E; ++Sub) {
+        summarizeLoop(*Sub, SE, Summaries, Memory, Footprint);
+
+        const LoopRecord &Summary = Summaries[*Sub];
+        Nested.NumberOfBlocks += Summary.NumberOfBlocks;
+        Nested.Features += Summary.Features;
+        Nested.BytesPerIteration += Summary.BytesPerIteration * std::max(Summary.Iterations, 1u);
+        Nested.Dynamic += Summary.Dynamic; // Block frequencies already account for nesting.
+      }
+
+      LoopRecord &Summary = Summaries[L];
+
+      Summary.NumberOfBlocks += Nested.NumberOfBlocks;
+      Summary.Features += Nested.Features;
+      Summary.BytesPerIteration += Nested.BytesPerIteration;
+      Summary.Dynamic += Nested.Dynamic;
+      Summary.Depth = L->getLoopDepth();
+      Summary.Iterations = TripCount;
+      Summary.Stride = getInductionStep(L, SE);
+      Summary.Footprint = Footprint.get();
+
+      Parent.add(Footprint);
+    }
+
+    // Step of the first integer induction variable of L with a constant
+    // step, from the AddRec of its header PHI; 0 when L has none.
+    //
+    int getInductionStep(Loop *L, ScalarEvolution *SE) {
+
+      for(BasicBlock::iterator BI = L->getHeader()->begin(); PHINode *PHI = dyn_cast<PHINode>(&*BI); ++BI) {
+
+        if (!PHI->getType()->isIntegerTy() || !SE->isSCEVable(PHI->getType()))
+          continue;
+
+        if (const SCEVAddRecExpr *AddRec = dyn_cast<SCEVAddRecExpr>(SE->getSCEV(PHI)))
+          if (AddRec->getLoop() == L && AddRec->isAffine())
+            if (const SCEVConstant *Step = dyn_cast<SCEVConstant>(AddRec->getStepRecurrence(*SE)))
+              return Step->getValue()->getSExtValue();
+      }
+
+      return 0;
+    }
+
+    // Access pattern of the R and W records of a block, in the deep tier.
+    //
+    void classifyAccesses(BlockRecord &Block, Loop *L, ScalarEvolution *SE) {
+
+      for (unsigned i = 0; i < Block.Accesses.size(); i++) {
+
+        AccessRecord &Access = Block.Accesses[i];
+        Instruction *I = const_cast<Instruction *>(static_cast<const Instruction *>(Access.Addr));
+        Value *Pointer = Access.IsWrite ? cast<StoreInst>(I)->getPointerOperand()
+                                        : cast<LoadInst>(I)->getPointerOperand();
+
+        std::pair<Value *, Loop *> Key(Pointer, L);
+        DenseMap<std::pair<Value *, Loop *>, std::pair<AccessPattern, int64_t> >::iterator It = Patterns.find(Key);
+
+        if (It == Patterns.end())
+          It = Patterns.insert(std::make_pair(Key, getAccessPattern(Pointer, Access.SizeInBytes, L, SE))).first;
+
+        Access.Pattern = It->second.first;
+        Access.StrideInBytes = It->second.second;
+      }
+    }
+
+    // Classify the addresses of Pointer across the iterations of L from its
+    // SCEV AddRec. The stride is in bytes.
+    //
+    std::pair<AccessPattern, int64_t> getAccessPattern(Value *Pointer, uint64_t Size, Loop *L, ScalarEvolution *SE) {
+
+      if (!L)
+        return std::make_pair(FSIG_ACCESS_CONSTANT, int64_t(0));
+
+      std::unique_lock<std::mutex> Lock = lockContext();
+      const SCEV *Address = SE->getSCEV(Pointer);
+
+      if (SE->isLoopInvariant(Address, L))
+        return std::make_pair(FSIG_ACCESS_CONSTANT, int64_t(0));
+
+      if (const SCEVAddRecExpr *AddRec = dyn_cast<SCEVAddRecExpr>(Address))
+        if (AddRec->getLoop() == L && AddRec->isAffine())
+          if (const SCEVConstant *Step = dyn_cast<SCEVConstant>(AddRec->getStepRecurrence(*SE))) {
+
+            int64_t Stride = Step->getValue()->getSExtValue();
+
+            if (Stride == int64_t(Size) || Stride == -int64_t(Size))
+              return std::make_pair(FSIG_ACCESS_UNIT, Stride);
+
+            return std::make_pair(FSIG_ACCESS_STRIDED, Stride);
+          }
+
+      LoadInLoopFinder Finder(L);
+      visitAll(Address, Finder);
+
+      if (Finder.Found)
+        return std::make_pair(FSIG_ACCESS_INDIRECT, int64_t(0));
+
+      return std::make_pair(FSIG_ACCESS_UNKNOWN, int64_t(0));
+    }
+
+    // Metadata Information
+
+  void getFunctionSignature(Function *F, FunctionRecord &Record) {
+
+    if (F->hasMetadata()) {
+
+      llvm::DISubprogram *SP = F->getSubprogram();
+
+      if (!SP) // Only !prof metadata.
+        return;
+
+      unsigned line = SP->getLine();
+
+       llvm::DIScope *Scope = dyn_cast<DIScope>(SP->getScope());
+
+      Record.HasDebugInfo = true;
+      Record.File = (Scope->getDirectory() + "/" + Scope->getFilename()).str();
+      Record.Line = line;
+    }
+  }
+
+    // Input from parameter List.
+    //
+    //
+    long int getInputFunction(Function *F, FunctionRecord &Record) {
+      long  int InputData = 0; // Bits
+      long int InputDataBytes = 0; // Bytes
+
+      int arg_index=0;
+
+      Function::ArgumentListType & Arg_List = F->getArgumentList();
+
+      for (Function::arg_iterator AB = Arg_List.begin(), AE = Arg_List.end(); AB != AE; ++AB){
+
+        llvm::Argument *Arg = &*AB;
+        llvm::Type *Arg_Type = Arg->getType();
+
+
+        ParamRecord Param;
+        raw_string_ostream TypeName(Param.Type);
+        TypeSummary Summary = Types.get(Arg_Type);
+
+        long int InputDataOfArg = Summary.SizeInBits;
+        TypeName << *Arg_Type;
+        TypeName.flush();
+
+        Param.Addr = Arg;
+        Param.Name = AB->getName();
+        Param.TypeWalk = Summary.Walk;
+        Param.NumberOfBits = InputDataOfArg;
+        Param.PaddingInBits = Summary.PaddingInBits;
+        Param.Alignment = Summary.Alignment;
+        Record.Params.push_back(Param);
+
+        InputData += InputDataOfArg;
+        arg_index++;
+
+       }
+
+       InputDataBytes = InputData/8;
+
+      return InputDataBytes;
+    }
+
+  };
+
+} // End of namespace llvm
+
+#endif
@@ -0,0 +1,697 @@
+//===--------------------- FunctionSignatureCache.h -----------------------===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the Università della Svizzera italiana (USI)
+// Open Source License.
+//
+// Author         : Georgios Zacharopoulos
+// Date Started   : April, 2019
+//
+//===----------------------------------------------------------------------===//
+//
+// Persistent cache of FunctionRecords keyed by a structural hash of the
+// Function, so that only new or changed Functions are analyzed again.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef FUNCTION_SIGNATURE_CACHE_H
+#define FUNCTION_SIGNATURE_CACHE_H
+
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/SetVector.h"
+#include "llvm/ADT/StringRef.h"
+#include "llvm/IR/Constants.h"
+#include "llvm/IR/DebugInfoMetadata.h"
+#include "llvm/IR/Function.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/IR/Module.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/MathExtras.h"
+#include "llvm/Support/MD5.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/raw_ostream.h"
+#include "FunctionSignature.h"
+#include "FunctionSignatureOutput.h"
+#include <atomic>
+#include <string>
+
+namespace llvm {
+
+  // Version of the on-disk format. Bump it whenever FunctionRecord changes;
+  // a cache written by another version is ignored.
+  //
+  static const uint32_t FSIG_CACHE_VERSION = 13;
+
+  // Structural hash of a Function. It covers everything its record depends
+  // on: the DataLayout and target triple of its Module, block and value
+  // names, opcodes, flags and predicates, types (named structs with their
+  // body), operands (local values by position, constants by value, aggregate
+  // and vector constants element by element, globals by name), the profile
+  // entry count and branch weights, the debug location and the instruction
+  // count of every callee. The sizes of the argument types follow from their
+  // types and the DataLayout. It is stable across runs, so pointers are
+  // never hashed.
+  //
+  class FunctionHasher {
+
+    MD5 Hash;
+    DenseMap<Value *, unsigned int> Locals; // Position of blocks, arguments and instructions.
+    DenseMap<StructType *, uint64_t> Bodies; // Digest of every named struct hashed so far.
+
+    void add(uint64_t Value) {
+      uint8_t Bytes[8];
+
+      for (unsigned i = 0; i < 8; i++)
+        Bytes[i] = Value >> (8 * i);
+
+      Hash.update(ArrayRef<uint8_t>(Bytes, 8));
+    }
+
+    // Every word, so that integers wider than 64 bits are not clamped.
+    void add(const APInt &Value) {
+      add(Value.getBitWidth());
+
+      for (unsigned i = 0; i < Value.getNumWords(); i++)
+        add(Value.getRawData()[i]);
+    }
+
+    void add(StringRef Str) {
+      add(Str.size());
+      Hash.update(Str);
+    }
+
+    unsigned int getLocal(Value *V) {
+      return Locals.insert(std::make_pair(V, Locals.size())).first->second;
+    }
+
+    // Named structs by name and the digest of their body, or, within a body,
+    // queued in Nested to be hashed once.
+    void addType(Type *Ty, SetVector<StructType *> *Nested = nullptr) {
+
+      add(Ty->getTypeID());
+
+      if (StructType *ST = dyn_cast<StructType>(Ty))
+        if (ST->hasName()) {
+          add(ST->getName());
+
+          if (Nested)
+            Nested->insert(ST);
+          else
+            add(getBodyDigest(ST));
+
+          return;
+        }
+
+      if (IntegerType *IT = dyn_cast<IntegerType>(Ty))
+        add(IT->getBitWidth());
+      else if (Ty->isArrayTy())
+        add(Ty->getArrayNumElements());
+      else if (Ty->isVectorTy())
+        add(Ty->getVectorNumElements());
+
+      for (unsigned i = 0; i < Ty->getNumContainedTypes(); i++)
+        addType(Ty->getContainedType(i), Nested);
+    }
+
+    // Digest of the body of ST and of every named struct it reaches, in the
+    // order they are reached, so that a recursive struct is hashed once.
+    uint64_t getBodyDigest(StructType *ST) {
+
+      DenseMap<StructType *, uint64_t>::iterator It = Bodies.find(ST);
+
+      if (It != Bodies.end())
+        return It->second;
+
+      FunctionHasher Body;
+      SetVector<StructType *> Nested;
+
+      Nested.insert(ST);
+
+      for (unsigned i = 0; i < Nested.size(); i++) {
+        StructType *Reached = Nested[i];
+
+        Body.add(Reached->isOpaque());
+        Body.add(Reached->isPacked());
+        Body.add(Reached->getNumElements());
+
+        for (unsigned e = 0; e < Reached->getNumElements(); e++)
+          Body.addType(Reached->getElementType(e), &Nested);
+      }
+
+      return Bodies[ST] = Body.getKey();
+    }
+
+    uint64_t getKey() {
+
+      MD5::MD5Result Result;
+      Hash.final(Result);
+
+      uint64_t Key = 0;
+      for (unsigned i = 0; i < 8; i++)
+        Key |= uint64_t(Result[i]) << (8 * i);
+
+      return Key;
+    }
+
+    void addOperand(Value *V) {
+
+      add(V->getValueID());
+
+      if (isa<Instruction>(V) || isa<Argument>(V) || isa<BasicBlock>(V))
+        add(getLocal(V));
+      else if (GlobalValue *GV = dyn_cast<GlobalValue>(V))
+        add(GV->getName());
+      else if (ConstantInt *CI = dyn_cast<ConstantInt>(V))
+        add(CI->getValue());
+      else if (ConstantFP *CFP = dyn_cast<ConstantFP>(V))
+        add(CFP->getValueAPF().bitcastToAPInt());
+      else if (ConstantDataSequential *CDS = dyn_cast<ConstantDataSequential>(V))
+        add(CDS->getRawDataValues());
+      else if (isa<ConstantArray>(V) || isa<ConstantStruct>(V) || isa<ConstantVector>(V)) {
+        Constant *Aggregate = cast<Constant>(V);
+        add(Aggregate->getNumOperands());
+        for (unsigned i = 0; i < Aggregate->getNumOperands(); i++)
+          addOperand(Aggregate->getOperand(i));
+      }
+      else if (ConstantExpr *CE = dyn_cast<ConstantExpr>(V)) {
+        add(CE->getOpcode());
+        for (unsigned i = 0; i < CE->getNumOperands(); i++)
+          addOperand(CE->getOperand(i));
+      }
+      // Null pointers, undef and zero aggregates are told apart by their
+      // value ID and type alone.
+
+      addType(V->getType());
+    }
+
+  public:
+
+    // Options is a fingerprint of the settings the record depends on beyond
+    // the IR and the tier, as the latency table of the pipeline estimates.
+    uint64_t hash(Function &F, unsigned int Level, SignatureRegistry &Registry, uint64_t Options = 0) {
+
+      add(FSIG_CACHE_VERSION);
+      add(Level);
+      add(Options);
+      add(F.getParent()->getDataLayoutStr());
+      add(F.getParent()->getTargetTriple());
+      add(F.getName());
+      add(F.getLinkage());
+      add(getEntryCount(&F));
+
+      if (DISubprogram *SP = F.getSubprogram()) {
+        add(SP->getDirectory());
+        add(SP->getFilename());
+        add(SP->getLine());
+      }
+
+      for (Function::arg_iterator AB = F.arg_begin(), AE = F.arg_end(); AB != AE; ++AB) {
+        add(AB->getName());
+        addType(AB->getType());
+        getLocal(&*AB);
+      }
+
+      for(Function::iterator BB = F.begin(), E = F.end(); BB != E; ++BB) {
+
+        add(BB->getName());
+        getLocal(&*BB);
+
+        for(BasicBlock::iterator BI = BB->begin(), BE = BB->end(); BI != BE; ++BI) {
+          Instruction *I = &*BI;
+
+          add(I->getOpcode());
+          add(I->getName());
+          add(I->getRawSubclassOptionalData());
+          addType(I->getType());
+          getLocal(I);
+
+          if (CmpInst *CI = dyn_cast<CmpInst>(I))
+            add(CI->getPredicate());
+
+          for (unsigned i = 0; i < I->getNumOperands(); i++)
+            addOperand(I->getOperand(i));
+
+          // Branch weights feed BlockFrequencyInfo.
+          if (MDNode *Weights = I->getMetadata(LLVMContext::MD_prof))
+            for (unsigned i = 0; i < Weights->getNumOperands(); i++)
+              if (ConstantInt *Weight = mdconst::dyn_extract<ConstantInt>(Weights->getOperand(i)))
+                add(Weight->getZExtValue());
+
+          if (CallInst *CI = dyn_cast<CallInst>(I))
+            if (Function *Callee = CI->getCalledFunction())
+              add(Registry.getNumberOfInstructions(Callee));
+        }
+      }
+
+      return getKey() >> 1; // Keep clear of the empty and tombstone keys of DenseMap.
+    }
+  };
+
+
+  // Binary encoding of FunctionRecords, shared by the cache and the summary
+  // files: little-endian 64-bit integers and length-prefixed strings. The
+  // addr: fields are not stored and read back as null.
+  //
+  struct RecordSerializer {
+
+    // Writer
+    //
+    static void write(raw_ostream &OS, uint64_t Value) {
+      for (unsigned i = 0; i < 8; i++)
+        OS << char(Value >> (8 * i));
+    }
+
+    static void write(raw_ostream &OS, StringRef Str) {
+      write(OS, Str.size());
+      OS << Str;
+    }
+
+    static void write(raw_ostream &OS, const BlockFeatures &Features) {
+      write(OS, Features.NumberOfInstructions);
+      write(OS, Features.Loads);
+      write(OS, Features.Stores);
+      write(OS, Features.Calls);
+      write(OS, Features.CondBranches);
+      write(OS, Features.IntOps);
+      write(OS, Features.FloatOps);
+      write(OS, Features.Compares);
+      write(OS, Features.Casts);
+      write(OS, Features.AddressOps);
+      write(OS, Features.ControlOps);
+      write(OS, Features.OtherOps);
+      write(OS, Features.BytesLoaded);
+      write(OS, Features.BytesStored);
+    }
+
+    static void write(raw_ostream &OS, const DynamicCounts &Dynamic) {
+      write(OS, Dynamic.Instructions);
+      write(OS, Dynamic.Loads);
+      write(OS, Dynamic.Stores);
+      write(OS, Dynamic.ArithmeticOps);
+      write(OS, Dynamic.BytesLoaded);
+      write(OS, Dynamic.BytesStored);
+    }
+
+    static void write(raw_ostream &OS, const FootprintRecord &Footprint) {
+      write(OS, Footprint.BytesRead);
+      write(OS, Footprint.BytesWritten);
+      write(OS, Footprint.Fallbacks);
+    }
+
+    static void write(raw_ostream &OS, const LoopDependences &Deps) {
+      write(OS, Deps.Computed);
+      write(OS, Deps.Carried);
+      write(OS, Deps.Unknown);
+      write(OS, Deps.MinDistance);
+      write(OS, Deps.Records.size());
+
+      for (unsigned i = 0; i < Deps.Records.size(); i++) {
+        write(OS, Deps.Records[i].Kind);
+        write(OS, Deps.Records[i].Src);
+        write(OS, Deps.Records[i].Dst);
+        write(OS, Deps.Records[i].Vector);
+        write(OS, Deps.Records[i].Distance);
+      }
+    }
+
+    static void write(raw_ostream &OS, const PipelineRecord &Pipeline) {
+      write(OS, Pipeline.Computed);
+      write(OS, Pipeline.RecII);
+      write(OS, Pipeline.ResII);
+      write(OS, Pipeline.II);
+      write(OS, Pipeline.Depth);
+      write(OS, Pipeline.Cycles);
+    }
+
+    static void write(raw_ostream &OS, const FunctionRecord &R) {
+
+      write(OS, R.Name);
+      write(OS, R.IsLocal);
+      write(OS, R.CallFreq);
+      write(OS, R.Features);
+      write(OS, R.HasDebugInfo);
+      write(OS, R.File);
+      write(OS, R.Line);
+      write(OS, R.HasDynamicCounts);
+      write(OS, R.IsProfiled);
+      write(OS, R.Dynamic);
+      write(OS, R.Params.size());
+
+      for (unsigned i = 0; i < R.Params.size(); i++) {
+        const ParamRecord &P = R.Params[i];
+
+        write(OS, P.Name);
+        write(OS, P.Type);
+        write(OS, P.TypeWalk);
+        write(OS, P.NumberOfBits);
+        write(OS, P.PaddingInBits);
+        write(OS, P.Alignment);
+      }
+
+      write(OS, R.Footprint);
+
+      write(OS, R.Sketch.size());
+      for (unsigned i = 0; i < R.Sketch.size(); i++)
+        write(OS, R.Sketch[i]);
+
+      write(OS, R.Blocks.size());
+
+      for (unsigned b = 0; b < R.Blocks.size(); b++) {
+        const BlockRecord &BB = R.Blocks[b];
+
+        write(OS, BB.Name);
+        write(OS, BB.Features);
+        write(OS, DoubleToBits(BB.Frequency));
+        write(OS, BB.Dynamic);
+        write(OS, BB.Branches.size());
+        for (unsigned i = 0; i < BB.Branches.size(); i++)
+          write(OS, BB.Branches[i]);
+
+        write(OS, BB.HasLoop);
+        write(OS, BB.Loop.Depth);
+        write(OS, BB.Loop.Iterations);
+        write(OS, BB.Loop.Stride);
+        write(OS, BB.Loop.LoopCarriedDeps);
+        write(OS, BB.Loop.NumberOfBlocks);
+        write(OS, BB.Loop.Features);
+        write(OS, BB.Loop.BytesPerIteration);
+        write(OS, BB.Loop.Dynamic);
+        write(OS, BB.Loop.Footprint);
+        write(OS, BB.Loop.Dependences);
+        write(OS, BB.Loop.Pipeline);
+
+        write(OS, BB.Accesses.size());
+        for (unsigned i = 0; i < BB.Accesses.size(); i++) {
+          write(OS, BB.Accesses[i].IsWrite);
+          write(OS, BB.Accesses[i].Name);
+          write(OS, BB.Accesses[i].SizeInBytes);
+          write(OS, BB.Accesses[i].Pattern);
+          write(OS, BB.Accesses[i].StrideInBytes);
+        }
+
+        write(OS, BB.Calls.size());
+        for (unsigned i = 0; i < BB.Calls.size(); i++) {
+          write(OS, BB.Calls[i].Name);
+          write(OS, BB.Calls[i].NumberOfInstructions);
+        }
+      }
+    }
+
+    // Reader. Every read checks the bounds of the buffer; a truncated or
+    // corrupt cache is dropped as a whole.
+    //
+    struct Reader {
+      StringRef Buffer;
+      bool Error;
+
+      Reader(StringRef Buffer) : Buffer(Buffer), Error(false) {}
+
+      uint64_t read() {
+
+        if (Buffer.size() < 8) {
+          Error = true;
+          return 0;
+        }
+
+        uint64_t Value = 0;
+        for (unsigned i = 0; i < 8; i++)
+          Value |= uint64_t((unsigned char)Buffer[i]) << (8 * i);
+
+        Buffer = Buffer.drop_front(8);
+        return Value;
+      }
+
+      template <typename T> void read(T &Value) { Value = (T)read(); }
+
+      void read(std::string &Str) {
+
+        uint64_t Size = read();
+
+        if (Error || Buffer.size() < Size) {
+          Error = true;
+          return;
+        }
+
+        Str = Buffer.substr(0, Size);
+        Buffer = Buffer.drop_front(Size);
+      }
+
+      // Counts are checked against the bytes left, so that a corrupt count
+      // cannot allocate without bound.
+      uint64_t readCount() {
+
+        uint64_t Count = read();
+
+        if (Count > Buffer.size()) {
+          Error = true;
+          return 0;
+        }
+
+        return Count;
+      }
+
+      // Keys are hashes shifted right by one; a key with the top bit set,
+      // as the empty and tombstone keys of DenseMap, is corrupt.
+      uint64_t readKey() {
+
+        uint64_t Key = read();
+
+        if (Key > (~0ULL >> 1)) {
+          Error = true;
+          return 0;
+        }
+
+        return Key;
+      }
+
+      void read(BlockFeatures &Features) {
+        read(Features.NumberOfInstructions);
+        read(Features.Loads);
+        read(Features.Stores);
+        read(Features.Calls);
+        read(Features.CondBranches);
+        read(Features.IntOps);
+        read(Features.FloatOps);
+        read(Features.Compares);
+        read(Features.Casts);
+        read(Features.AddressOps);
+        read(Features.ControlOps);
+        read(Features.OtherOps);
+        read(Features.BytesLoaded);
+        read(Features.BytesStored);
+      }
+
+      void read(DynamicCounts &Dynamic) {
+        read(Dynamic.Instructions);
+        read(Dynamic.Loads);
+        read(Dynamic.Stores);
+        read(Dynamic.ArithmeticOps);
+        read(Dynamic.BytesLoaded);
+        read(Dynamic.BytesStored);
+      }
+
+      void read(FootprintRecord &Footprint) {
+        read(Footprint.BytesRead);
+        read(Footprint.BytesWritten);
+        read(Footprint.Fallbacks);
+      }
+
+      void read(LoopDependences &Deps) {
+        read(Deps.Computed);
+        read(Deps.Carried);
+        read(Deps.Unknown);
+        read(Deps.MinDistance);
+
+        Deps.Records.resize(readCount());
+        for (unsigned i = 0; i < Deps.Records.size() && !Error; i++) {
+          read(Deps.Records[i].Kind);
+          read(Deps.Records[i].Src);
+          read(Deps.Records[i].Dst);
+          read(Deps.Records[i].Vector);
+          read(Deps.Records[i].Distance);
+          Deps.Records[i].SrcAddr = Deps.Records[i].DstAddr = nullptr;
+        }
+      }
+
+      void read(PipelineRecord &Pipeline) {
+        read(Pipeline.Computed);
+        read(Pipeline.RecII);
+        read(Pipeline.ResII);
+        read(Pipeline.II);
+        read(Pipeline.Depth);
+        read(Pipeline.Cycles);
+      }
+
+      void read(FunctionRecord &R) {
+
+        read(R.Name);
+        read(R.IsLocal);
+        read(R.CallFreq);
+        read(R.Features);
+        read(R.HasDebugInfo);
+        read(R.File);
+        read(R.Line);
+        read(R.HasDynamicCounts);
+        read(R.IsProfiled);
+        read(R.Dynamic);
+
+        R.Params.resize(readCount());
+        for (unsigned i = 0; i < R.Params.size() && !Error; i++) {
+          ParamRecord &P = R.Params[i];
+
+          P.Addr = nullptr;
+          read(P.Name);
+          read(P.Type);
+          read(P.TypeWalk);
+          read(P.NumberOfBits);
+          read(P.PaddingInBits);
+          read(P.Alignment);
+        }
+
+        read(R.Footprint);
+
+        R.Sketch.resize(readCount());
+        for (unsigned i = 0; i < R.Sketch.size() && !Error; i++)
+          read(R.Sketch[i]);
+
+        R.Blocks.resize(readCount());
+
+        for (unsigned b = 0; b < R.Blocks.size() && !Error; b++) {
+          BlockRecord &BB = R.Blocks[b];
+
+          read(BB.Name);
+          read(BB.Features);
+          BB.Frequency = BitsToDouble(read());
+          read(BB.Dynamic);
+          BB.Branches.resize(readCount());
+          for (unsigned i = 0; i < BB.Branches.size() && !Error; i++)
+            read(BB.Branches[i]);
+
+          read(BB.HasLoop);
+          read(BB.Loop.Depth);
+          read(BB.Loop.Iterations);
+          read(BB.Loop.Stride);
+          read(BB.Loop.LoopCarriedDeps);
+          read(BB.Loop.NumberOfBlocks);
+          read(BB.Loop.Features);
+          read(BB.Loop.BytesPerIteration);
+          read(BB.Loop.Dynamic);
+          read(BB.Loop.Footprint);
+          read(BB.Loop.Dependences);
+          read(BB.Loop.Pipeline);
+
+          BB.Accesses.resize(readCount());
+          for (unsigned i = 0; i < BB.Accesses.size() && !Error; i++) {
+            BB.Accesses[i].Addr = nullptr;
+            read(BB.Accesses[i].IsWrite);
+            read(BB.Accesses[i].Name);
+            read(BB.Accesses[i].SizeInBytes);
+            read(BB.Accesses[i].Pattern);
+            read(BB.Accesses[i].StrideInBytes);
+          }
+
+          BB.Calls.resize(readCount());
+          for (unsigned i = 0; i < BB.Calls.size() && !Error; i++) {
+            read(BB.Calls[i].Name);
+            read(BB.Calls[i].NumberOfInstructions);
+          }
+        }
+      }
+    };
+  };
+
+
+  // Records of a previous run, loaded from and saved to the file given with
+  // -fsig-cache. On a hit FunctionSignatureAnalyzer::relink refreshes the
+  // P[...] records and fills the addr: fields, which are not stored.
+  //
+  class SignatureCache {
+
+    DenseMap<uint64_t, FunctionRecord> Records; // Loaded from the file.
+    std::vector<std::pair<uint64_t, FunctionRecord> > Current; // Records of this run.
+    mutable std::atomic<unsigned int> Hits; // Successful lookups, for -stats.
+
+    static StringRef magic() { return "FSIGCACHE"; }
+
+  public:
+
+    SignatureCache() : Hits(0) {}
+
+    // A missing cache is not an error: the first run starts empty.
+    void load(StringRef Filename) {
+
+      ErrorOr<std::unique_ptr<MemoryBuffer>> File = MemoryBuffer::getFile(Filename);
+
+      if (!File)
+        return;
+
+      RecordSerializer::Reader In((*File)->getBuffer());
+
+      if (!In.Buffer.startswith(magic()))
+        return;
+
+      In.Buffer = In.Buffer.drop_front(magic().size());
+
+      if (In.read() != FSIG_CACHE_VERSION)
+        return;
+
+      uint64_t Count = In.readCount();
+
+      for (uint64_t i = 0; i < Count && !In.Error; i++) {
+        uint64_t Key = In.readKey();
+
+        if (!In.Error)
+          In.read(Records[Key]);
+      }
+
+      if (In.Error) {
+        errs() << "FunctionSignature: ignoring corrupt cache '" << Filename << "'\n";
+        Records.clear();
+      }
+    }
+
+    void insert(uint64_t Key, const FunctionRecord &Record) {
+      Current.push_back(std::make_pair(Key, Record));
+    }
+
+    // Only the records of this run are saved, so the cache does not keep
+    // Functions that were removed.
+    void save(StringRef Filename) const {
+
+      std::error_code EC;
+      raw_fd_ostream OS(Filename, EC, sys::fs::F_None);
+
+      if (EC) {
+        errs() << "FunctionSignature: cannot write cache '" << Filename << "': " << EC.message() << "\n";
+        return;
+      }
+
+      OS << magic();
+      RecordSerializer::write(OS, FSIG_CACHE_VERSION);
+      RecordSerializer::write(OS, Current.size());
+
+      for (unsigned i = 0; i < Current.size(); i++) {
+        RecordSerializer::write(OS, Current[i].first);
+        RecordSerializer::write(OS, Current[i].second);
+      }
+    }
+
+    const FunctionRecord *lookup(uint64_t Key) const {
+
+      DenseMap<uint64_t, FunctionRecord>::const_iterator It = Records.find(Key);
+
+      if (It == Records.end())
+        return nullptr;
+
+      Hits++;
+
+      return &It->second;
+    }
+
+    unsigned int getNumberOfHits() const { return Hits; }
+  };
+
+} // End of namespace llvm
+
+#endif
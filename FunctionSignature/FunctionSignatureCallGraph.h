@@ -0,0 +1,190 @@
+//===-------------------- FunctionSignatureCallGraph.h --------------------===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the Università della Svizzera italiana (USI)
+// Open Source License.
+//
+// Author         : Georgios Zacharopoulos
+// Date Started   : April, 2019
+//
+//===----------------------------------------------------------------------===//
+//
+// Inclusive cost of every Function, aggregated bottom-up over the SCCs of the
+// call graph of a Module.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef FUNCTION_SIGNATURE_CALL_GRAPH_H
+#define FUNCTION_SIGNATURE_CALL_GRAPH_H
+
+#include "llvm/ADT/GraphTraits.h"
+#include "llvm/ADT/SCCIterator.h"
+#include "llvm/ADT/SmallPtrSet.h"
+#include "llvm/ADT/StringExtras.h"
+#include "llvm/ADT/StringMap.h"
+#include "FunctionSignatureOutput.h"
+#include <algorithm>
+#include <vector>
+
+namespace llvm {
+
+  // Call graph over the FunctionRecords of a Module, built from their C[...]
+  // records rather than from the IR, so that it is still available once the
+  // bodies are gone (fsig) and when records of several Modules are merged.
+  // Units gives the Module of every record when they come from several; a
+  // call resolves to a Function of its own Module first, and then to one
+  // that is not local to another Module. The root calls every Function, so
+  // that scc_iterator reaches all of them.
+  //
+  struct RecordCallGraph {
+
+    struct Node {
+      FunctionRecord *Record; // Null for the root.
+      unsigned int Unit;
+      std::vector<Node *> Callees; // One per call edge to a defined Function.
+
+      Node() : Record(nullptr), Unit(0) {}
+    };
+
+    std::vector<Node> Nodes; // Nodes[0] is the root.
+    StringMap<Node *> Local; // Every Function, by Unit and name.
+    StringMap<Node *> Global; // Functions visible to the other Modules.
+
+    static std::string getLocalKey(unsigned int Unit, StringRef Name) {
+      return utostr(Unit) + ":" + Name.str();
+    }
+
+    RecordCallGraph(std::vector<FunctionRecord> &Records, const std::vector<unsigned int> *Units = nullptr)
+      : Nodes(Records.size() + 1) {
+
+      for (unsigned i = 0; i < Records.size(); i++) {
+        Node &N = Nodes[i + 1];
+
+        N.Record = &Records[i];
+        N.Unit = Units ? (*Units)[i] : 0;
+        Nodes[0].Callees.push_back(&N);
+        Local[getLocalKey(N.Unit, Records[i].Name)] = &N;
+
+        if (!Records[i].IsLocal)
+          Global[Records[i].Name] = &N;
+      }
+
+      for (unsigned i = 0; i < Records.size(); i++)
+        for (unsigned b = 0; b < Records[i].Blocks.size(); b++) {
+          const std::vector<CallRecord> &Calls = Records[i].Blocks[b].Calls;
+
+          for (unsigned c = 0; c < Calls.size(); c++)
+            if (Node *Callee = resolve(Nodes[i + 1], Calls[c].Name))
+              Nodes[i + 1].Callees.push_back(Callee);
+        }
+    }
+
+    // Node of the Function that Caller calls by Name, null for declarations.
+    Node *resolve(const Node &Caller, StringRef Name) const {
+
+      if (Node *Callee = Local.lookup(getLocalKey(Caller.Unit, Name)))
+        return Callee;
+
+      return Global.lookup(Name);
+    }
+  };
+
+  template <> struct GraphTraits<RecordCallGraph *> {
+    typedef RecordCallGraph::Node NodeType;
+    typedef std::vector<NodeType *>::iterator ChildIteratorType;
+
+    static NodeType *getEntryNode(RecordCallGraph *G) { return &G->Nodes[0]; }
+    static ChildIteratorType child_begin(NodeType *N) { return N->Callees.begin(); }
+    static ChildIteratorType child_end(NodeType *N) { return N->Callees.end(); }
+  };
+
+  inline void addScaled(DynamicCounts &To, const DynamicCounts &From, double Scale) {
+    To.Instructions += From.Instructions * Scale + 0.5;
+    To.Loads += From.Loads * Scale + 0.5;
+    To.Stores += From.Stores * Scale + 0.5;
+    To.ArithmeticOps += From.ArithmeticOps * Scale + 0.5;
+    To.BytesLoaded += From.BytesLoaded * Scale + 0.5;
+    To.BytesStored += From.BytesStored * Scale + 0.5;
+  }
+
+  // Fill the InclusiveCost of every record. scc_iterator visits the SCCs
+  // bottom-up, so the cost of each callee outside the SCC is final, and
+  // memoized in its record, when its callers are visited. Calls between the
+  // members of a recursive SCC are not followed; the SCC is costed once and
+  // shared by its members.
+  //
+  inline void computeInclusiveCosts(std::vector<FunctionRecord> &Records,
+                                    const std::vector<unsigned int> *Units = nullptr) {
+
+    RecordCallGraph Graph(Records, Units);
+
+    for (scc_iterator<RecordCallGraph *> SCC = scc_begin(&Graph); !SCC.isAtEnd(); ++SCC) {
+
+      const std::vector<RecordCallGraph::Node *> &Members = *SCC;
+      SmallPtrSet<FunctionRecord *, 4> InSCC;
+      InclusiveCost Cost;
+
+      for (unsigned m = 0; m < Members.size(); m++)
+        if (Members[m]->Record)
+          InSCC.insert(Members[m]->Record);
+
+      if (InSCC.empty()) // The root.
+        continue;
+
+      Cost.Recursive = Members.size() > 1 || SCC.hasLoop();
+
+      for (unsigned m = 0; m < Members.size(); m++) {
+
+        const FunctionRecord &R = *Members[m]->Record;
+        double Calls = std::max(R.CallFreq, 1);
+
+        Cost.Instructions += R.Features.NumberOfInstructions;
+        Cost.Loads += R.Features.Loads;
+        Cost.Stores += R.Features.Stores;
+        Cost.Dynamic += R.Dynamic;
+
+        for (unsigned b = 0; b < R.Blocks.size(); b++) {
+          const BlockRecord &BB = R.Blocks[b];
+
+          // Calls without a C[...] record are the indirect ones.
+          if (BB.Features.Calls > BB.Calls.size())
+            Cost.IndirectCalls += BB.Features.Calls - BB.Calls.size();
+
+          for (unsigned c = 0; c < BB.Calls.size(); c++) {
+
+            RecordCallGraph::Node *CalleeNode = Graph.resolve(*Members[m], BB.Calls[c].Name);
+            FunctionRecord *Callee = CalleeNode ? CalleeNode->Record : nullptr;
+
+            if (!Callee) {
+              Cost.ExternalCalls++;
+              continue;
+            }
+
+            if (InSCC.count(Callee))
+              continue;
+
+            const InclusiveCost &CalleeCost = Callee->Inclusive;
+
+            Cost.Instructions += CalleeCost.Instructions;
+            Cost.Loads += CalleeCost.Loads;
+            Cost.Stores += CalleeCost.Stores;
+            Cost.IndirectCalls += CalleeCost.IndirectCalls;
+            Cost.ExternalCalls += CalleeCost.ExternalCalls;
+
+            // Executions of the call site over one call of the callee.
+            addScaled(Cost.Dynamic, CalleeCost.Dynamic, BB.Frequency * Calls / std::max(Callee->CallFreq, 1));
+          }
+        }
+      }
+
+      for (unsigned m = 0; m < Members.size(); m++) {
+        Members[m]->Record->Inclusive = Cost;
+        Members[m]->Record->HasInclusiveCost = true;
+      }
+    }
+  }
+
+} // End of namespace llvm
+
+#endif
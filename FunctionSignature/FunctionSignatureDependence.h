@@ -0,0 +1,287 @@
+//===-------------------- FunctionSignatureDependence.h -------------------===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the Università della Svizzera italiana (USI)
+// Open Source License.
+//
+// Author         : Georgios Zacharopoulos
+// Date Started   : April, 2019
+//
+//===----------------------------------------------------------------------===//
+//
+// Loop-carried dependences through memory, from the distance and direction
+// vectors of DependenceAnalysis, collected per loop for the deep tier.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef FUNCTION_SIGNATURE_DEPENDENCE_H
+#define FUNCTION_SIGNATURE_DEPENDENCE_H
+
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/StringExtras.h"
+#include "llvm/Analysis/DependenceAnalysis.h"
+#include "llvm/Analysis/LoopInfo.h"
+#include "llvm/Analysis/ScalarEvolutionExpressions.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/IR/IntrinsicInst.h"
+#include "llvm/Pass.h"
+#include "FunctionSignatureOutput.h"
+#include <cstdlib>
+#include <memory>
+#include <vector>
+
+namespace llvm {
+
+  // Dependences of the Loops of a Function, by header. Loops are keyed by
+  // block, so that the map outlives the LoopInfo it was computed with.
+  typedef DenseMap<BasicBlock *, LoopDependences> LoopDependenceMap;
+
+  // Pairs of accesses a loop nest is tested for, at most. DependenceAnalysis
+  // is quadratic in the accesses of a nest; past this every Loop of the nest
+  // gets one unknown dependence instead.
+  static const unsigned int FSIG_MAX_DEPENDENCE_PAIRS = 4096;
+
+  class LoopDependenceCollector {
+
+    DependenceAnalysis &DA;
+    LoopInfo &LI;
+    LoopDependenceMap &Loops;
+
+    static const char *getDirectionName(unsigned Direction) {
+
+      switch (Direction) {
+        case Dependence::DVEntry::LT: return "<";
+        case Dependence::DVEntry::EQ: return "=";
+        case Dependence::DVEntry::GT: return ">";
+        case Dependence::DVEntry::LE: return "<=";
+        case Dependence::DVEntry::GE: return ">=";
+        case Dependence::DVEntry::NE: return "<>";
+        default:                      return "*";
+      }
+    }
+
+    // The same direction seen from the sink.
+    static unsigned reverseDirection(unsigned Direction) {
+
+      unsigned Reversed = Direction & Dependence::DVEntry::EQ;
+
+      if (Direction & Dependence::DVEntry::LT)
+        Reversed |= Dependence::DVEntry::GT;
+
+      if (Direction & Dependence::DVEntry::GT)
+        Reversed |= Dependence::DVEntry::LT;
+
+      return Reversed;
+    }
+
+    static int64_t getConstantDistance(const Dependence &D, unsigned Level, bool &IsConstant) {
+
+      const SCEVConstant *Distance = dyn_cast_or_null<SCEVConstant>(D.getDistance(Level));
+
+      IsConstant = Distance != nullptr;
+
+      return Distance ? Distance->getValue()->getSExtValue() : 0;
+    }
+
+    static Value *getPointer(Instruction *I) {
+
+      if (LoadInst *Load = dyn_cast<LoadInst>(I))
+        return Load->getPointerOperand();
+
+      return cast<StoreInst>(I)->getPointerOperand();
+    }
+
+    // Calls that may write memory are not tested by DependenceAnalysis. Debug
+    // and lifetime markers do not count.
+    static bool isOpaqueWrite(Instruction &I) {
+
+      if (isa<LoadInst>(I) || isa<StoreInst>(I) || !I.mayWriteToMemory())
+        return false;
+
+      if (IntrinsicInst *II = dyn_cast<IntrinsicInst>(&I))
+        return II->getIntrinsicID() != Intrinsic::lifetime_start &&
+               II->getIntrinsicID() != Intrinsic::lifetime_end;
+
+      return true;
+    }
+
+    // Loop of the nest of Inner at the given depth.
+    static Loop *getLoopAtDepth(Loop *Inner, unsigned Depth) {
+
+      while (Inner && Inner->getLoopDepth() > Depth)
+        Inner = Inner->getParentLoop();
+
+      return Inner;
+    }
+
+    void markComputed(Loop *L) {
+
+      Loops[L->getHeader()].Computed = true;
+
+      for (Loop::iterator Sub = L->begin(), E = L->end(); Sub != E; ++Sub)
+        markComputed(*Sub);
+    }
+
+    void addUnknown(Loop *L) {
+
+      Loops[L->getHeader()].Unknown++;
+
+      for (Loop::iterator Sub = L->begin(), E = L->end(); Sub != E; ++Sub)
+        addUnknown(*Sub);
+    }
+
+    // Attribute D to the Loop that carries it, the outermost one of the common
+    // nest whose direction is not =. A dependence that is = at every level
+    // is within one iteration, and is not carried. The vector is turned around
+    // when the dependence goes from Dst to Src, so that every distance of a
+    // record is read from its source.
+    void addDependence(Instruction *Src, Instruction *Dst, const Dependence &D, Loop *Common) {
+
+      unsigned Levels = D.getLevels();
+      unsigned Carrier = 0;
+
+      for (unsigned Level = 1; Level <= Levels && !Carrier; Level++)
+        if (D.getDirection(Level) != Dependence::DVEntry::EQ)
+          Carrier = Level;
+
+      if (!Carrier)
+        return;
+
+      bool IsConstant;
+      int64_t Distance = getConstantDistance(D, Carrier, IsConstant);
+      bool Reversed = IsConstant ? Distance < 0 : D.getDirection(Carrier) == Dependence::DVEntry::GT;
+      LoopDependences &Deps = Loops[getLoopAtDepth(Common, Carrier)->getHeader()];
+      DependenceRecord Record;
+
+      Record.Src = getPointer(Reversed ? Dst : Src)->getName();
+      Record.Dst = getPointer(Reversed ? Src : Dst)->getName();
+      Record.Distance = IsConstant ? std::abs(Distance) : 0;
+      Record.SrcAddr = Reversed ? Dst : Src;
+      Record.DstAddr = Reversed ? Src : Dst;
+
+      if (D.isOutput())
+        Record.Kind = FSIG_DEP_OUTPUT;
+      else
+        Record.Kind = D.isFlow() != Reversed ? FSIG_DEP_FLOW : FSIG_DEP_ANTI;
+
+      for (unsigned Level = 1; Level <= Levels; Level++) {
+
+        bool LevelIsConstant;
+        int64_t LevelDistance = getConstantDistance(D, Level, LevelIsConstant);
+        unsigned Direction = D.getDirection(Level);
+
+        Record.Vector += Level > 1 ? " " : "";
+
+        if (LevelIsConstant)
+          Record.Vector += itostr(Reversed ? -LevelDistance : LevelDistance);
+        else
+          Record.Vector += getDirectionName(Reversed ? reverseDirection(Direction) : Direction);
+      }
+
+      if (IsConstant) {
+        Deps.Carried++;
+
+        if (!Deps.MinDistance || (unsigned)Record.Distance < Deps.MinDistance)
+          Deps.MinDistance = Record.Distance;
+      }
+      else
+        Deps.Unknown++;
+
+      Deps.Records.push_back(Record);
+    }
+
+    void collectNest(Loop *Top) {
+
+      std::vector<Instruction *> Accesses;
+
+      markComputed(Top);
+
+      for (Loop::block_iterator BB = Top->block_begin(), E = Top->block_end(); BB != E; ++BB)
+        for(BasicBlock::iterator BI = (*BB)->begin(), BE = (*BB)->end(); BI != BE; ++BI) {
+
+          if (isa<LoadInst>(&*BI) || isa<StoreInst>(&*BI))
+            Accesses.push_back(&*BI);
+          else if (isOpaqueWrite(*BI))
+            for (Loop *L = LI.getLoopFor(*BB); L; L = L->getParentLoop())
+              Loops[L->getHeader()].Unknown++;
+        }
+
+      if ((uint64_t)Accesses.size() * (Accesses.size() + 1) / 2 > FSIG_MAX_DEPENDENCE_PAIRS) {
+        addUnknown(Top);
+        return;
+      }
+
+      for (unsigned i = 0; i < Accesses.size(); i++)
+        for (unsigned j = i; j < Accesses.size(); j++) {
+
+          if (isa<LoadInst>(Accesses[i]) && isa<LoadInst>(Accesses[j]))
+            continue;
+
+          std::unique_ptr<Dependence> D = DA.depends(Accesses[i], Accesses[j], true);
+
+          if (!D)
+            continue;
+
+          Loop *Common = LI.getLoopFor(Accesses[i]->getParent());
+
+          while (!Common->contains(Accesses[j]))
+            Common = Common->getParentLoop();
+
+          // Any Loop of the common nest may carry it.
+          if (D->isConfused()) {
+            for (Loop *L = Common; L; L = L->getParentLoop())
+              Loops[L->getHeader()].Unknown++;
+            continue;
+          }
+
+          addDependence(Accesses[i], Accesses[j], *D, Common);
+        }
+    }
+
+  public:
+
+    LoopDependenceCollector(DependenceAnalysis &DA, LoopInfo &LI, LoopDependenceMap &Loops)
+      : DA(DA), LI(LI), Loops(Loops) {}
+
+    void collect() {
+      for (LoopInfo::iterator L = LI.begin(), E = LI.end(); L != E; ++L)
+        collectNest(*L);
+    }
+  };
+
+  // DependenceAnalysis only runs under the legacy pass manager, so the
+  // dependences are collected by a pass of their own. The FunctionSignature
+  // pass and fsig run it in a legacy::FunctionPassManager, and
+  // FunctionSignatureParallel asks for it on its main thread, one batch of
+  // Functions at a time, while no worker runs; all of them only for the
+  // Functions the record cache misses.
+  //
+  struct LoopDependencePass : public FunctionPass {
+    static char ID; // Pass Identification, replacement for typeid
+
+    LoopDependenceMap Loops;
+
+    LoopDependencePass() : FunctionPass(ID) {}
+
+    bool runOnFunction(Function &F) override {
+
+      Loops.clear();
+      LoopDependenceCollector(getAnalysis<DependenceAnalysis>(), getAnalysis<LoopInfoWrapperPass>().getLoopInfo(),
+                              Loops).collect();
+
+      return false;
+    }
+
+    void getAnalysisUsage(AnalysisUsage &AU) const override {
+      AU.addRequired<LoopInfoWrapperPass>();
+      AU.addRequired<DependenceAnalysis>();
+      AU.setPreservesAll();
+    }
+
+    const LoopDependenceMap &getLoops() const { return Loops; }
+  };
+
+} // End of namespace llvm
+
+#endif
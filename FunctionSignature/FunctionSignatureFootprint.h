@@ -0,0 +1,292 @@
+//===-------------------- FunctionSignatureFootprint.h --------------------===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the Università della Svizzera italiana (USI)
+// Open Source License.
+//
+// Author         : Georgios Zacharopoulos
+// Date Started   : April, 2019
+//
+//===----------------------------------------------------------------------===//
+//
+// Memory footprint of a Function or of a loop: the distinct bytes it reads
+// and writes in one call, or in one execution of the loop, from the SCEV
+// address ranges of its loads and stores across the trip counts.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef FUNCTION_SIGNATURE_FOOTPRINT_H
+#define FUNCTION_SIGNATURE_FOOTPRINT_H
+
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/Analysis/LoopInfo.h"
+#include "llvm/Analysis/ScalarEvolution.h"
+#include "llvm/Analysis/ScalarEvolutionExpressions.h"
+#include "llvm/Analysis/ValueTracking.h"
+#include "llvm/IR/DataLayout.h"
+#include "llvm/IR/GlobalVariable.h"
+#include "llvm/IR/Instructions.h"
+#include "FunctionSignatureOutput.h"
+#include <algorithm>
+#include <vector>
+
+namespace llvm {
+
+  // A load or a store, as seen by the feature walk.
+  struct MemoryAccess {
+    Value *Pointer;
+    uint64_t Size; // Store size of the accessed type.
+    bool IsWrite;
+  };
+
+  // Every access of the region covers an interval of offsets from a base
+  // SCEV, the part of its address that does not change in the region.
+  // Overlapping intervals of the same base are merged, so A[i] and A[i+1]
+  // count once. The footprint of a loop is built from the merged intervals
+  // of its nested loops, widened across its own trip count, and the one of
+  // the Function from its outermost loops, so that every access is only
+  // added once. An interval that SCEV cannot widen, for a non-affine address
+  // or an unknown trip count, takes the size of the array it points into,
+  // and is otherwise counted once per iteration.
+  //
+  class FootprintEstimator {
+
+    struct Interval {
+      int64_t Lo;
+      int64_t Hi;
+      uint64_t Distinct; // Bytes of the interval actually touched, for strided accesses.
+      Value *Pointer; // Of one of its accesses, for the array it points into.
+      unsigned int Accesses; // Merged into it, not counting the whole arrays.
+
+      bool operator<(const Interval &Other) const { return Lo < Other.Lo; }
+    };
+
+    typedef DenseMap<const SCEV *, std::vector<Interval> > RangeMap;
+
+    ScalarEvolution *SE; // Null in the cheap tier.
+    const DenseMap<const Loop *, unsigned int> &TripCounts; // Of the region and its nested Loops.
+    const DataLayout &DL;
+    Loop *Region;
+    RangeMap Ranges[2]; // Read, written.
+    DenseMap<Value *, uint64_t> Arrays[2]; // Whole arrays, without SCEV.
+    uint64_t Unmerged[2]; // Per execution of the region.
+    unsigned int Fallbacks;
+
+    // Iterations of the region in one execution of it.
+    uint64_t getIterations() const {
+      return Region ? std::max(TripCounts.lookup(Region), 1u) : 1;
+    }
+
+    // Move the constant term of S, and of the start of an AddRec of a Loop
+    // outside the region, into Offset, so that A[i][j] and A[i][j+1] share
+    // their base.
+    const SCEV *splitOffset(const SCEV *S, int64_t &Offset) {
+
+      if (const SCEVAddExpr *Add = dyn_cast<SCEVAddExpr>(S))
+        if (const SCEVConstant *Constant = dyn_cast<SCEVConstant>(Add->getOperand(0))) {
+          Offset += Constant->getValue()->getSExtValue();
+          return SE->getMinusSCEV(S, Constant);
+        }
+
+      if (const SCEVAddRecExpr *AddRec = dyn_cast<SCEVAddRecExpr>(S))
+        if (AddRec->isAffine()) {
+          const SCEV *Start = splitOffset(AddRec->getStart(), Offset);
+
+          if (Start != AddRec->getStart())
+            return SE->getAddRecExpr(Start, AddRec->getStepRecurrence(*SE), AddRec->getLoop(),
+                                     SCEV::FlagAnyWrap);
+        }
+
+      return S;
+    }
+
+    // Widen Range across the iterations of the region, peeling one AddRec of
+    // the region at a time off Base: {{A,+,400}<i>,+,4}<j> covers 400 * (I-1)
+    // + 4 * (J-1) bytes past A, once both loops are peeled. What remains of
+    // Base must not change in the region.
+    bool widen(const SCEV *&Base, Interval &Range) {
+
+      while (const SCEVAddRecExpr *AddRec = dyn_cast<SCEVAddRecExpr>(Base)) {
+
+        if (Region && !Region->contains(AddRec->getLoop()))
+          break;
+
+        const SCEVConstant *Step = dyn_cast<SCEVConstant>(AddRec->getStepRecurrence(*SE));
+        unsigned int TripCount = TripCounts.lookup(AddRec->getLoop());
+
+        if (!AddRec->isAffine() || !Step || !TripCount)
+          return false;
+
+        int64_t Distance = Step->getValue()->getSExtValue() * int64_t(TripCount - 1);
+
+        if (Distance < 0)
+          Range.Lo += Distance;
+        else
+          Range.Hi += Distance;
+
+        Range.Distinct = std::min(Range.Distinct * TripCount, uint64_t(Range.Hi - Range.Lo));
+        Base = AddRec->getStart();
+      }
+
+      if (Region && !SE->isLoopInvariant(Base, Region))
+        return false;
+
+      int64_t Offset = 0;
+
+      Base = splitOffset(Base, Offset);
+      Range.Lo += Offset;
+      Range.Hi += Offset;
+
+      return true;
+    }
+
+    // Allocated size of the array behind Pointer, or 0 when it is not known.
+    uint64_t getArraySize(Value *Object) const {
+
+      Type *Ty = nullptr;
+
+      if (AllocaInst *Alloca = dyn_cast<AllocaInst>(Object)) {
+        if (!Alloca->isArrayAllocation())
+          Ty = Alloca->getAllocatedType();
+      }
+      else if (GlobalVariable *Global = dyn_cast<GlobalVariable>(Object))
+        Ty = Global->getValueType();
+      else if (isa<Argument>(Object))
+        Ty = Object->getType()->getPointerElementType(); // Only a pointer to an array has a size.
+
+      if (!Ty || !Ty->isSized() || (isa<Argument>(Object) && !Ty->isArrayTy()))
+        return 0;
+
+      return DL.getTypeAllocSize(Ty);
+    }
+
+    // Range covers one iteration of the region, or one execution of it when
+    // it is the whole Function.
+    void add(const SCEV *Base, Interval Range, bool IsWrite) {
+
+      if (SE && widen(Base, Range)) {
+        Ranges[IsWrite][Base].push_back(Range);
+        return;
+      }
+
+      Fallbacks += Range.Accesses;
+
+      Value *Object = GetUnderlyingObject(Range.Pointer, DL);
+      uint64_t ArraySize = getArraySize(Object);
+
+      if (!ArraySize)
+        Unmerged[IsWrite] += Range.Distinct * getIterations();
+      else if (SE) {
+        Interval Whole = { 0, int64_t(ArraySize), ArraySize, Range.Pointer, 0 };
+        Ranges[IsWrite][SE->getSCEV(Object)].push_back(Whole);
+      }
+      else
+        Arrays[IsWrite][Object] = ArraySize;
+    }
+
+    // Overlapping intervals of one base, merged.
+    static std::vector<Interval> merge(std::vector<Interval> Intervals) {
+
+      std::vector<Interval> Merged;
+
+      std::sort(Intervals.begin(), Intervals.end());
+
+      for (unsigned i = 0; i < Intervals.size(); i++) {
+
+        if (Merged.empty() || Intervals[i].Lo >= Merged.back().Hi) {
+          Merged.push_back(Intervals[i]);
+          continue;
+        }
+
+        Interval &Last = Merged.back();
+        Last.Hi = std::max(Last.Hi, Intervals[i].Hi);
+        Last.Distinct += Intervals[i].Distinct;
+        Last.Accesses += Intervals[i].Accesses;
+      }
+
+      for (unsigned i = 0; i < Merged.size(); i++)
+        Merged[i].Distinct = std::min(Merged[i].Distinct, uint64_t(Merged[i].Hi - Merged[i].Lo));
+
+      return Merged;
+    }
+
+    uint64_t getBytes(bool IsWrite) const {
+
+      uint64_t Bytes = Unmerged[IsWrite];
+
+      for (DenseMap<Value *, uint64_t>::const_iterator It = Arrays[IsWrite].begin(), E = Arrays[IsWrite].end();
+           It != E; ++It)
+        Bytes += It->second;
+
+      for (RangeMap::const_iterator It = Ranges[IsWrite].begin(), E = Ranges[IsWrite].end(); It != E; ++It) {
+
+        std::vector<Interval> Merged = merge(It->second);
+
+        for (unsigned i = 0; i < Merged.size(); i++)
+          Bytes += Merged[i].Distinct;
+      }
+
+      return Bytes;
+    }
+
+  public:
+
+    // Region is the Loop to estimate, or null for the whole Function. The trip
+    // counts are those SCEV gave once per Loop, 0 when unknown.
+    FootprintEstimator(ScalarEvolution *SE, const DenseMap<const Loop *, unsigned int> &TripCounts,
+                       const DataLayout &DL, Loop *Region)
+      : SE(SE), TripCounts(TripCounts), DL(DL), Region(Region), Fallbacks(0) {
+      Unmerged[0] = Unmerged[1] = 0;
+    }
+
+    // An access of a block whose innermost Loop is the region, or that is
+    // outside every Loop for the Function.
+    void add(const MemoryAccess &Access) {
+
+      Interval Range = { 0, int64_t(Access.Size), Access.Size, Access.Pointer, 1 };
+
+      if (Access.Size)
+        add(SE ? SE->getSCEV(Access.Pointer) : nullptr, Range, Access.IsWrite);
+    }
+
+    // The footprint of a Loop nested right in the region, once all of its
+    // own nested Loops were added to it.
+    void add(const FootprintEstimator &Inner) {
+
+      Fallbacks += Inner.Fallbacks;
+
+      for (unsigned IsWrite = 0; IsWrite < 2; IsWrite++) {
+
+        Unmerged[IsWrite] += Inner.Unmerged[IsWrite] * getIterations();
+
+        for (DenseMap<Value *, uint64_t>::const_iterator It = Inner.Arrays[IsWrite].begin(),
+               E = Inner.Arrays[IsWrite].end(); It != E; ++It)
+          Arrays[IsWrite][It->first] = It->second;
+
+        for (RangeMap::const_iterator It = Inner.Ranges[IsWrite].begin(), E = Inner.Ranges[IsWrite].end();
+             It != E; ++It) {
+
+          std::vector<Interval> Merged = merge(It->second);
+
+          for (unsigned i = 0; i < Merged.size(); i++)
+            add(It->first, Merged[i], IsWrite);
+        }
+      }
+    }
+
+    FootprintRecord get() const {
+
+      FootprintRecord Footprint;
+
+      Footprint.BytesRead = getBytes(false);
+      Footprint.BytesWritten = getBytes(true);
+      Footprint.Fallbacks = Fallbacks;
+
+      return Footprint;
+    }
+  };
+
+} // End of namespace llvm
+
+#endif
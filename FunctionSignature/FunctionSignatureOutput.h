@@ -0,0 +1,988 @@
+//===--------------------- FunctionSignatureOutput.h ----------------------===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the Università della Svizzera italiana (USI)
+// Open Source License.
+//
+// Author         : Georgios Zacharopoulos
+// Date Started   : April, 2019
+//
+//===----------------------------------------------------------------------===//
+//
+// Records produced by the FunctionSignature pass and the writers that print
+// them, either in the legacy F[...] text format, as JSON lines, or as a
+// columnar feature matrix.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef FUNCTION_SIGNATURE_OUTPUT_H
+#define FUNCTION_SIGNATURE_OUTPUT_H
+
+#include "llvm/ADT/StringExtras.h"
+#include "llvm/ADT/StringMap.h"
+#include "llvm/ADT/StringRef.h"
+#include "llvm/ADT/Twine.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/ErrorHandling.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/Format.h"
+#include "llvm/Support/raw_ostream.h"
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace llvm {
+
+  // Version of the JSON-lines schema. Bump it whenever a field changes meaning
+  // or is removed; new fields may be added without a bump.
+  //   2: n_bit is the DataLayout size of the data, padding included.
+  //   3: loop n_of_instructions covers the whole loop, and every block in a
+  //      loop reports its accesses and calls.
+  //   4: in the deep tier, loop lcds also counts the memory dependences the
+  //      loop carries, with a constant distance or unknown.
+  //   5: loop stride is the step of the induction variable of the loop.
+  //
+  static const unsigned int FSIG_SCHEMA_VERSION = 5;
+
+  enum SignatureFormat { FSIG_TEXT, FSIG_JSON, FSIG_NPY };
+
+  // Number of MinHash values in the sketch of a Function.
+  //
+  static const unsigned int FSIG_SKETCH_SIZE = 64;
+
+  // P[...] record: one argument of the Function.
+  struct ParamRecord {
+    const void *Addr;
+    std::string Name;
+    std::string Type; // LLVM type of the argument.
+    std::string TypeWalk; // Legacy rendering of the type walk.
+    long int NumberOfBits; // DataLayout size of the data, pointers followed.
+    uint64_t PaddingInBits;
+    unsigned int Alignment;
+  };
+
+  // Pattern of the addresses of a load or store across the iterations of its
+  // innermost loop, from the SCEV of its pointer. Only the deep tier
+  // classifies accesses.
+  enum AccessPattern {
+    FSIG_ACCESS_UNCLASSIFIED,
+    FSIG_ACCESS_CONSTANT, // Loop invariant, or outside loops.
+    FSIG_ACCESS_UNIT, // Affine, the stride is the size of the access.
+    FSIG_ACCESS_STRIDED, // Affine with another constant stride.
+    FSIG_ACCESS_INDIRECT, // Depends on a value loaded in the loop.
+    FSIG_ACCESS_UNKNOWN
+  };
+
+  inline const char *getAccessPatternName(AccessPattern Pattern) {
+
+    switch (Pattern) {
+      case FSIG_ACCESS_CONSTANT: return "constant";
+      case FSIG_ACCESS_UNIT:     return "unit";
+      case FSIG_ACCESS_STRIDED:  return "strided";
+      case FSIG_ACCESS_INDIRECT: return "indirect";
+      default:                   return "unknown";
+    }
+  }
+
+  // R[...] and W[...] records, in instruction order.
+  struct AccessRecord {
+    bool IsWrite;
+    const void *Addr;
+    std::string Name;
+    uint64_t SizeInBytes; // Store size of the accessed type.
+    AccessPattern Pattern;
+    int64_t StrideInBytes; // Per iteration, for unit and strided accesses.
+  };
+
+  // Kind of a dependence through memory, from its source to its sink in
+  // iteration order: read after write, write after read, write after write.
+  enum DependenceKind { FSIG_DEP_FLOW, FSIG_DEP_ANTI, FSIG_DEP_OUTPUT };
+
+  inline const char *getDependenceKindName(DependenceKind Kind) {
+
+    switch (Kind) {
+      case FSIG_DEP_FLOW: return "flow";
+      case FSIG_DEP_ANTI: return "anti";
+      default:            return "output";
+    }
+  }
+
+  // D[...] record: a dependence through memory carried by a loop. Vector has
+  // one entry per loop of the nest, outermost first: the distance when it is
+  // constant, or the direction (<, =, >, <=, >=, <>, *) otherwise.
+  struct DependenceRecord {
+    DependenceKind Kind;
+    std::string Src; // Names of the pointers, as in the R and W records.
+    std::string Dst;
+    std::string Vector;
+    int Distance; // At the carrying loop; 0 when it is not constant.
+    const void *SrcAddr; // The source and sink instructions, as the Addr of
+    const void *DstAddr; // an AccessRecord; null when read from a cache.
+  };
+
+  // Dependences through memory carried by a loop, from DependenceAnalysis in
+  // the deep tier. A dependence is carried by the outermost loop of the nest
+  // whose direction is not =.
+  struct LoopDependences {
+    bool Computed;
+    unsigned int Carried; // With a constant distance.
+    unsigned int Unknown; // Unproven: confused, unknown distance, or calls that write memory.
+    unsigned int MinDistance; // Shortest constant distance, 0 without any.
+    std::vector<DependenceRecord> Records;
+
+    LoopDependences() : Computed(false), Carried(0), Unknown(0), MinDistance(0) {}
+  };
+
+  // C[...] record.
+  struct CallRecord {
+    std::string Name;
+    unsigned int NumberOfInstructions;
+  };
+
+  // Feature counters of a block, or of a whole Function, filled in a single
+  // walk over the instructions.
+  struct BlockFeatures {
+    unsigned int NumberOfInstructions;
+    unsigned int Loads;
+    unsigned int Stores;
+    unsigned int Calls; // Debug and lifetime intrinsics excluded.
+    unsigned int CondBranches;
+    // Opcode classes.
+    unsigned int IntOps;
+    unsigned int FloatOps;
+    unsigned int Compares;
+    unsigned int Casts;
+    unsigned int AddressOps; // getelementptr and alloca.
+    unsigned int ControlOps; // Terminators.
+    unsigned int OtherOps;
+    // Store sizes of the loaded and stored types.
+    uint64_t BytesLoaded;
+    uint64_t BytesStored;
+
+    BlockFeatures()
+      : NumberOfInstructions(0), Loads(0), Stores(0), Calls(0), CondBranches(0), IntOps(0),
+        FloatOps(0), Compares(0), Casts(0), AddressOps(0), ControlOps(0), OtherOps(0),
+        BytesLoaded(0), BytesStored(0) {}
+
+    // Integer and floating point binary operators.
+    uint64_t getArithmeticOps() const { return IntOps + FloatOps; }
+
+    BlockFeatures &operator+=(const BlockFeatures &Other) {
+      NumberOfInstructions += Other.NumberOfInstructions;
+      Loads += Other.Loads;
+      Stores += Other.Stores;
+      Calls += Other.Calls;
+      CondBranches += Other.CondBranches;
+      IntOps += Other.IntOps;
+      FloatOps += Other.FloatOps;
+      Compares += Other.Compares;
+      Casts += Other.Casts;
+      AddressOps += Other.AddressOps;
+      ControlOps += Other.ControlOps;
+      OtherOps += Other.OtherOps;
+      BytesLoaded += Other.BytesLoaded;
+      BytesStored += Other.BytesStored;
+      return *this;
+    }
+  };
+
+  // Instruction, load, store, arithmetic and byte counts weighted by
+  // BlockFrequencyInfo: per call of the Function, times its profile entry
+  // count when it has one.
+  struct DynamicCounts {
+    uint64_t Instructions;
+    uint64_t Loads;
+    uint64_t Stores;
+    uint64_t ArithmeticOps;
+    uint64_t BytesLoaded;
+    uint64_t BytesStored;
+
+    DynamicCounts() : Instructions(0), Loads(0), Stores(0), ArithmeticOps(0), BytesLoaded(0), BytesStored(0) {}
+
+    DynamicCounts &operator+=(const DynamicCounts &Other) {
+      Instructions += Other.Instructions;
+      Loads += Other.Loads;
+      Stores += Other.Stores;
+      ArithmeticOps += Other.ArithmeticOps;
+      BytesLoaded += Other.BytesLoaded;
+      BytesStored += Other.BytesStored;
+      return *this;
+    }
+  };
+
+  // Arithmetic intensity of a Function or loop: arithmetic operations per
+  // byte loaded or stored, from the dynamic counts when there are some and
+  // from the static ones, loops times their trip count, otherwise. Level is
+  // how many of the Levels machine balance points (-fsig-balance) the
+  // intensity reaches, -1 when there are none.
+  struct RooflineRecord {
+    uint64_t ArithmeticOps;
+    uint64_t Bytes;
+    double OpsPerByte;
+    int Level;
+    unsigned int Levels;
+
+    RooflineRecord() : ArithmeticOps(0), Bytes(0), OpsPerByte(0), Level(-1), Levels(0) {}
+
+    const char *getBound() const {
+      return Level <= 0 ? "memory" : (unsigned)Level >= Levels ? "compute" : "balanced";
+    }
+  };
+
+  // Distinct bytes read and written by one call of a Function, or by one
+  // execution of a loop. Fallbacks counts the accesses whose address range
+  // SCEV could not bound, which are sized from their array type or counted
+  // once per iteration.
+  struct FootprintRecord {
+    uint64_t BytesRead;
+    uint64_t BytesWritten;
+    unsigned int Fallbacks;
+
+    FootprintRecord() : BytesRead(0), BytesWritten(0), Fallbacks(0) {}
+  };
+
+  // Software pipeline of an innermost loop: its initiation interval is the
+  // larger of the one its recurrences allow (RecII) and the one the ports of
+  // its operations allow (ResII). Depth is the latency of one iteration, and
+  // Cycles is Iterations * II + Depth, 0 when the trip count is not known.
+  struct PipelineRecord {
+    bool Computed;
+    unsigned int RecII;
+    unsigned int ResII;
+    unsigned int II;
+    unsigned int Depth;
+    uint64_t Cycles;
+
+    PipelineRecord() : Computed(false), RecII(0), ResII(0), II(0), Depth(0), Cycles(0) {}
+  };
+
+  // L[...] record. The features cover every block of the loop, nested loops
+  // included.
+  struct LoopRecord {
+    unsigned int Depth;
+    unsigned int Iterations;
+    int Stride; // Step of the induction variable, 0 without one.
+    int LoopCarriedDeps;
+    unsigned int NumberOfBlocks;
+    BlockFeatures Features;
+    uint64_t BytesPerIteration; // Loads and stores; nested loops times their trip count.
+    DynamicCounts Dynamic; // All the executions of the loop.
+    FootprintRecord Footprint;
+    LoopDependences Dependences; // Also counted in LoopCarriedDeps.
+    RooflineRecord Roofline;
+    PipelineRecord Pipeline; // Innermost loops, from the standard tier.
+
+    LoopRecord()
+      : Depth(0), Iterations(0), Stride(0), LoopCarriedDeps(0), NumberOfBlocks(0), BytesPerIteration(0) {}
+
+    // Recurrences of the loop: none (its iterations are independent),
+    // register (through PHIs only), memory (constant distances) or unknown.
+    const char *getRecurrence() const {
+
+      if (Dependences.Unknown)
+        return "unknown";
+
+      if (Dependences.Carried)
+        return "memory";
+
+      return LoopCarriedDeps ? "register" : "none";
+    }
+  };
+
+  // BB[...] record.
+  struct BlockRecord {
+    std::string Name;
+    BlockFeatures Features;
+    std::vector<std::string> Branches; // Successors of a conditional branch.
+    bool HasLoop;
+    LoopRecord Loop;
+    std::vector<AccessRecord> Accesses;
+    std::vector<CallRecord> Calls;
+    double Frequency; // Executions per call of the Function.
+    DynamicCounts Dynamic;
+
+    BlockRecord() : HasLoop(false), Frequency(1.0) {}
+  };
+
+  // Cost of a Function and of everything it calls, one visit per call edge.
+  // The members of a recursive SCC share the cost of the whole SCC.
+  struct InclusiveCost {
+    uint64_t Instructions;
+    uint64_t Loads;
+    uint64_t Stores;
+    DynamicCounts Dynamic; // Callees scaled by the executions of each call site.
+    unsigned int IndirectCalls; // Call sites whose callee, and cost, is unknown.
+    unsigned int ExternalCalls; // Calls to declarations, with no cost.
+    bool Recursive;
+
+    InclusiveCost()
+      : Instructions(0), Loads(0), Stores(0), IndirectCalls(0), ExternalCalls(0), Recursive(false) {}
+  };
+
+  // F[...] record, self-contained.
+  struct FunctionRecord {
+    std::string Name;
+    bool IsLocal; // Internal or private linkage: not visible to other Modules.
+    int CallFreq;
+    BlockFeatures Features; // Sum over the blocks.
+    bool HasDebugInfo;
+    std::string File;
+    unsigned int Line;
+    std::vector<ParamRecord> Params;
+    FootprintRecord Footprint; // What the Params point to, globals and the stack.
+    std::vector<BlockRecord> Blocks;
+    bool HasDynamicCounts; // BlockFrequencyInfo was available (standard tier and up).
+    bool IsProfiled; // It has a profile entry count, rather than only the static heuristics of BlockFrequencyInfo.
+    DynamicCounts Dynamic;
+    bool HasInclusiveCost; // Filled over all the records of a Module; never cached.
+    InclusiveCost Inclusive;
+    bool HasRoofline; // Filled with the inclusive costs, for the loops too; never cached.
+    RooflineRecord Roofline;
+    std::vector<uint32_t> Sketch; // MinHash of the opcode n-grams, FSIG_SKETCH_SIZE values.
+
+    FunctionRecord()
+      : IsLocal(false), CallFreq(0), HasDebugInfo(false), Line(0), HasDynamicCounts(false), IsProfiled(false),
+        HasInclusiveCost(false), HasRoofline(false) {}
+  };
+
+  // S[...] record: two Functions, by index in the records of the Module, and
+  // the similarity of their sketches.
+  struct SimilarPair {
+    unsigned int First;
+    unsigned int Second;
+    double Similarity;
+  };
+
+
+  // JSON helpers
+  //
+  inline void writeJSONString(raw_ostream &OS, StringRef Str) {
+
+    OS << '"';
+
+    for (unsigned i = 0; i < Str.size(); i++) {
+      unsigned char C = Str[i];
+
+      switch (C) {
+        case '"':  OS << "\\\""; break;
+        case '\\': OS << "\\\\"; break;
+        case '\n': OS << "\\n";  break;
+        case '\t': OS << "\\t";  break;
+        case '\r': OS << "\\r";  break;
+        default:
+          if (C < 0x20)
+            OS << "\\u00" << hexdigit(C >> 4, true) << hexdigit(C & 0xF, true);
+          else
+            OS << C;
+      }
+    }
+
+    OS << '"';
+  }
+
+  inline void writeJSONAddr(raw_ostream &OS, const void *Addr) {
+    OS << '"' << Addr << '"';
+  }
+
+  inline void writeJSONFeatures(raw_ostream &OS, const BlockFeatures &Features) {
+    OS << "\"features\":{\"loads\":" << Features.Loads
+       << ",\"stores\":" << Features.Stores
+       << ",\"calls\":" << Features.Calls
+       << ",\"cond_branches\":" << Features.CondBranches
+       << ",\"int_ops\":" << Features.IntOps
+       << ",\"fp_ops\":" << Features.FloatOps
+       << ",\"cmp_ops\":" << Features.Compares
+       << ",\"cast_ops\":" << Features.Casts
+       << ",\"addr_ops\":" << Features.AddressOps
+       << ",\"control_ops\":" << Features.ControlOps
+       << ",\"other_ops\":" << Features.OtherOps
+       << ",\"bytes_loaded\":" << Features.BytesLoaded
+       << ",\"bytes_stored\":" << Features.BytesStored << "}";
+  }
+  inline void writeJSONDynamic(raw_ostream &OS, const DynamicCounts &Dynamic) {
+    OS << "\"dynamic\":{\"instructions\":" << Dynamic.Instructions
+       << ",\"loads\":" << Dynamic.Loads
+       << ",\"stores\":" << Dynamic.Stores
+       << ",\"arith_ops\":" << Dynamic.ArithmeticOps
+       << ",\"bytes_loaded\":" << Dynamic.BytesLoaded
+       << ",\"bytes_stored\":" << Dynamic.BytesStored << "}";
+  }
+  inline void writeJSONFootprint(raw_ostream &OS, const FootprintRecord &Footprint) {
+    OS << "\"footprint\":{\"bytes_read\":" << Footprint.BytesRead
+       << ",\"bytes_written\":" << Footprint.BytesWritten
+       << ",\"fallbacks\":" << Footprint.Fallbacks << "}";
+  }
+  inline void writeJSONRoofline(raw_ostream &OS, const RooflineRecord &Roofline) {
+    OS << "\"roofline\":{\"arith_ops\":" << Roofline.ArithmeticOps
+       << ",\"bytes\":" << Roofline.Bytes
+       << ",\"ops_per_byte\":" << format("%g", Roofline.OpsPerByte);
+
+    if (Roofline.Level >= 0)
+      OS << ",\"level\":" << Roofline.Level << ",\"bound\":\"" << Roofline.getBound() << "\"";
+
+    OS << "}";
+  }
+  inline void writeJSONPipeline(raw_ostream &OS, const PipelineRecord &Pipeline) {
+    OS << "\"pipeline\":{\"rec_ii\":" << Pipeline.RecII
+       << ",\"res_ii\":" << Pipeline.ResII
+       << ",\"ii\":" << Pipeline.II
+       << ",\"depth\":" << Pipeline.Depth
+       << ",\"cycles\":" << Pipeline.Cycles << "}";
+  }
+  inline void writeTextRoofline(raw_ostream &OS, const RooflineRecord &Roofline) {
+    if (Roofline.Level >= 0)
+      OS << "; ops_per_byte:" << format("%g", Roofline.OpsPerByte) << "; bound:" << Roofline.getBound();
+  }
+
+
+
+  // Legacy text format, identical to the one printed by the pass to errs().
+  //
+  inline void writeTextRecord(raw_ostream &OS, const FunctionRecord &R) {
+
+    OS << "\n\n" <<"F[name:" << R.Name << "; call_freq:" << R.CallFreq <<
+      "; n_of_instructions:" << R.Features.NumberOfInstructions;
+
+    if (R.HasRoofline)
+      writeTextRoofline(OS, R.Roofline);
+
+    OS << "] {\n";
+
+    for (unsigned i = 0; i < R.Params.size(); i++) {
+      const ParamRecord &P = R.Params[i];
+
+      OS << "\t P[addr:" << P.Addr <<"; name:" << P.Name << "; type:" << P.TypeWalk
+         << " n_bit:" << P.NumberOfBits << "; size:";
+
+      if (R.HasDebugInfo)
+        OS << "file: " << R.File << ";" << " line_number: " << R.Line << ";]";
+
+      OS << "]\n";
+    }
+
+    for (unsigned b = 0; b < R.Blocks.size(); b++) {
+      const BlockRecord &BB = R.Blocks[b];
+
+      OS << "\n\tBB[name:" << BB.Name << "; n_of_instructions:" << BB.Features.NumberOfInstructions << "]\n";
+
+      for (unsigned i = 0; i < BB.Branches.size(); i++)
+        OS << "\n\t  BranchInst (IF=0,ELSE=1): " << i << "\tSuccessor BB: " << BB.Branches[i];
+
+      if (BB.HasLoop)
+        OS << "\n\t  L[name:" << BB.Name << "; depth:" << BB.Loop.Depth
+           << "; iterations:" << BB.Loop.Iterations
+           << "; stride:" << BB.Loop.Stride
+           << "; lcds:" << BB.Loop.LoopCarriedDeps
+           << "; n_of_instructions:" << BB.Loop.Features.NumberOfInstructions;
+
+      if (BB.HasLoop && BB.Loop.Dependences.Computed)
+        OS << "; mem_lcds:" << BB.Loop.Dependences.Carried << "; unknown_lcds:" << BB.Loop.Dependences.Unknown
+           << "; recurrence:" << BB.Loop.getRecurrence();
+
+      if (BB.HasLoop && R.HasRoofline)
+        writeTextRoofline(OS, BB.Loop.Roofline);
+
+      if (BB.HasLoop && BB.Loop.Pipeline.Computed)
+        OS << "; ii:" << BB.Loop.Pipeline.II << "; pipeline_depth:" << BB.Loop.Pipeline.Depth
+           << "; cycles:" << BB.Loop.Pipeline.Cycles;
+
+      if (BB.HasLoop)
+        OS << "] {\n";
+
+      for (unsigned i = 0; BB.HasLoop && i < BB.Loop.Dependences.Records.size(); i++) {
+        const DependenceRecord &D = BB.Loop.Dependences.Records[i];
+        OS << "\t\tD[kind:" << getDependenceKindName(D.Kind) << "; src:" << D.Src << "; dst:" << D.Dst
+           << "; vector:[" << D.Vector << "]; distance:" << D.Distance << "]\n";
+      }
+
+      for (unsigned i = 0; i < BB.Accesses.size(); i++) {
+        const AccessRecord &A = BB.Accesses[i];
+        OS << (A.IsWrite ? "\t\tW[addr:" : "\t\tR[addr:") << A.Addr << "; name:" << A.Name
+           << "; offset:" << "NA;";
+
+        if (A.Pattern != FSIG_ACCESS_UNCLASSIFIED)
+          OS << " pattern:" << getAccessPatternName(A.Pattern) << "; stride:" << A.StrideInBytes
+             << "; size:" << A.SizeInBytes << ";";
+
+        OS << "]" << "\n";
+      }
+
+      for (unsigned i = 0; i < BB.Calls.size(); i++)
+        OS << "\t\tC[name: " << BB.Calls[i].Name
+           << "; n_of_instructions:" << BB.Calls[i].NumberOfInstructions << "]\n";
+
+      if (BB.HasLoop)
+        OS << "\t  }\n";
+    }
+
+    OS << " }" << '\n';
+  }
+
+
+  // JSON-lines format, one Function per line.
+  //
+  inline void writeJSONRecord(raw_ostream &OS, const FunctionRecord &R) {
+
+    OS << "{\"schema\":\"fsig\",\"version\":" << FSIG_SCHEMA_VERSION << ",\"kind\":\"function\",\"name\":";
+    writeJSONString(OS, R.Name);
+    OS << ",\"local\":" << (R.IsLocal ? "true" : "false");
+    OS << ",\"call_freq\":" << R.CallFreq << ",\"profiled\":" << (R.IsProfiled ? "true" : "false");
+    OS << ",\"n_of_instructions\":" << R.Features.NumberOfInstructions << ",";
+    writeJSONFeatures(OS, R.Features);
+
+    if (R.HasDynamicCounts) {
+      OS << ",";
+      writeJSONDynamic(OS, R.Dynamic);
+    }
+
+    if (R.HasRoofline) {
+      OS << ",";
+      writeJSONRoofline(OS, R.Roofline);
+    }
+
+    if (R.HasInclusiveCost) {
+      OS << ",\"inclusive\":{\"instructions\":" << R.Inclusive.Instructions
+         << ",\"loads\":" << R.Inclusive.Loads
+         << ",\"stores\":" << R.Inclusive.Stores
+         << ",\"indirect_calls\":" << R.Inclusive.IndirectCalls
+         << ",\"external_calls\":" << R.Inclusive.ExternalCalls
+         << ",\"recursive\":" << (R.Inclusive.Recursive ? "true" : "false");
+
+      if (R.HasDynamicCounts) {
+        OS << ",";
+        writeJSONDynamic(OS, R.Inclusive.Dynamic);
+      }
+
+      OS << "}";
+    }
+
+    if (!R.Sketch.empty()) {
+      OS << ",\"minhash\":\"";
+      for (unsigned i = 0; i < R.Sketch.size(); i++)
+        OS << format_hex_no_prefix(R.Sketch[i], 8);
+      OS << "\"";
+    }
+
+    if (R.HasDebugInfo) {
+      OS << ",\"file\":";
+      writeJSONString(OS, R.File);
+      OS << ",\"line_number\":" << R.Line;
+    }
+
+    OS << ",";
+    writeJSONFootprint(OS, R.Footprint);
+    OS << ",\"params\":[";
+    for (unsigned i = 0; i < R.Params.size(); i++) {
+      const ParamRecord &P = R.Params[i];
+
+      OS << (i ? "," : "") << "{\"addr\":";
+      writeJSONAddr(OS, P.Addr);
+      OS << ",\"name\":";
+      writeJSONString(OS, P.Name);
+      OS << ",\"type\":";
+      writeJSONString(OS, P.Type);
+      OS << ",\"n_bit\":" << P.NumberOfBits << ",\"padding_bit\":" << P.PaddingInBits
+         << ",\"align\":" << P.Alignment << "}";
+    }
+
+    OS << "],\"blocks\":[";
+    for (unsigned b = 0; b < R.Blocks.size(); b++) {
+      const BlockRecord &BB = R.Blocks[b];
+
+      OS << (b ? "," : "") << "{\"name\":";
+      writeJSONString(OS, BB.Name);
+      OS << ",\"n_of_instructions\":" << BB.Features.NumberOfInstructions << ",";
+      writeJSONFeatures(OS, BB.Features);
+
+      if (R.HasDynamicCounts) {
+        OS << ",\"frequency\":" << format("%g", BB.Frequency) << ",";
+        writeJSONDynamic(OS, BB.Dynamic);
+      }
+
+      OS << ",\"branches\":[";
+
+      for (unsigned i = 0; i < BB.Branches.size(); i++) {
+        OS << (i ? "," : "");
+        writeJSONString(OS, BB.Branches[i]);
+      }
+      OS << "]";
+
+      if (BB.HasLoop) {
+        OS << ",\"loop\":{\"depth\":" << BB.Loop.Depth
+           << ",\"iterations\":" << BB.Loop.Iterations
+           << ",\"stride\":" << BB.Loop.Stride
+           << ",\"lcds\":" << BB.Loop.LoopCarriedDeps;
+
+        if (BB.Loop.Dependences.Computed) {
+          const LoopDependences &Deps = BB.Loop.Dependences;
+
+          OS << ",\"mem_lcds\":" << Deps.Carried << ",\"unknown_lcds\":" << Deps.Unknown
+             << ",\"min_distance\":" << Deps.MinDistance
+             << ",\"recurrence\":\"" << BB.Loop.getRecurrence() << "\",\"dependences\":[";
+
+          for (unsigned i = 0; i < Deps.Records.size(); i++) {
+            const DependenceRecord &D = Deps.Records[i];
+
+            OS << (i ? "," : "") << "{\"kind\":\"" << getDependenceKindName(D.Kind) << "\",\"src\":";
+            writeJSONString(OS, D.Src);
+            OS << ",\"dst\":";
+            writeJSONString(OS, D.Dst);
+            OS << ",\"vector\":";
+            writeJSONString(OS, D.Vector);
+            OS << ",\"distance\":" << D.Distance << "}";
+          }
+
+          OS << "]";
+        }
+
+        OS << ",\"n_of_instructions\":" << BB.Loop.Features.NumberOfInstructions
+           << ",\"n_of_blocks\":" << BB.Loop.NumberOfBlocks
+           << ",\"bytes_per_iteration\":" << BB.Loop.BytesPerIteration << ",";
+        writeJSONFeatures(OS, BB.Loop.Features);
+        OS << ",";
+        writeJSONFootprint(OS, BB.Loop.Footprint);
+
+        if (R.HasDynamicCounts) {
+          OS << ",";
+          writeJSONDynamic(OS, BB.Loop.Dynamic);
+        }
+
+        if (R.HasRoofline) {
+          OS << ",";
+          writeJSONRoofline(OS, BB.Loop.Roofline);
+        }
+
+        if (BB.Loop.Pipeline.Computed) {
+          OS << ",";
+          writeJSONPipeline(OS, BB.Loop.Pipeline);
+        }
+
+        OS << "}";
+      }
+
+      OS << ",\"accesses\":[";
+      for (unsigned i = 0; i < BB.Accesses.size(); i++) {
+        const AccessRecord &A = BB.Accesses[i];
+
+        OS << (i ? "," : "") << "{\"kind\":\"" << (A.IsWrite ? "W" : "R") << "\",\"addr\":";
+        writeJSONAddr(OS, A.Addr);
+        OS << ",\"name\":";
+        writeJSONString(OS, A.Name);
+        OS << ",\"size\":" << A.SizeInBytes;
+
+        if (A.Pattern != FSIG_ACCESS_UNCLASSIFIED)
+          OS << ",\"pattern\":\"" << getAccessPatternName(A.Pattern) << "\",\"stride\":" << A.StrideInBytes;
+
+        OS << "}";
+      }
+
+      OS << "],\"calls\":[";
+      for (unsigned i = 0; i < BB.Calls.size(); i++) {
+        OS << (i ? "," : "") << "{\"name\":";
+        writeJSONString(OS, BB.Calls[i].Name);
+        OS << ",\"n_of_instructions\":" << BB.Calls[i].NumberOfInstructions << "}";
+      }
+      OS << "]}";
+    }
+
+    OS << "]}\n";
+  }
+
+
+  // Fixed-width numeric features, for training jobs that mmap them instead of
+  // parsing text. Saved as <prefix>.functions.npy, one row per Function, and
+  // <prefix>.loops.npy, one row per L[...] record: little-endian int64 NumPy
+  // arrays in Fortran order, so that every column is contiguous. Names are
+  // interned in <prefix>.strings, NUL-terminated, and the name columns hold
+  // their byte offset. <prefix>.columns names the columns of the matrices.
+  // <prefix>.sketches.npy holds the uint32 MinHash sketch of each Function,
+  // one per row, and <prefix>.similar.npy the S[...] records.
+  //
+  class FeatureMatrix {
+
+    typedef std::vector<std::vector<int64_t> > Columns;
+
+    StringMap<uint64_t> Offsets;
+    std::string Strings;
+    Columns Functions;
+    Columns Loops;
+    Columns Similar;
+    std::vector<uint32_t> Sketches;
+
+    uint64_t intern(StringRef Name) {
+
+      StringMap<uint64_t>::iterator It = Offsets.find(Name);
+
+      if (It != Offsets.end())
+        return It->second;
+
+      uint64_t Offset = Strings.size();
+
+      Strings.append(Name.begin(), Name.end());
+      Strings.push_back('\0');
+      Offsets[Name] = Offset;
+
+      return Offset;
+    }
+
+    static void addRow(Columns &Matrix, const int64_t *Row, unsigned Size) {
+
+      Matrix.resize(Size);
+
+      for (unsigned i = 0; i < Size; i++)
+        Matrix[i].push_back(Row[i]);
+    }
+
+    static raw_fd_ostream *open(const std::string &Filename) {
+
+      std::error_code EC;
+      raw_fd_ostream *OS = new raw_fd_ostream(Filename, EC, sys::fs::F_None);
+
+      if (EC)
+        report_fatal_error(Twine("FunctionSignature: cannot open '") + Filename + "': " + EC.message());
+
+      return OS;
+    }
+
+    // NPY format 1.0; the header is padded so that the data is 64-byte aligned.
+    static void writeHeader(raw_ostream &OS, StringRef Type, bool FortranOrder, uint64_t Rows, unsigned Width) {
+
+      std::string Header;
+
+      raw_string_ostream(Header) << "{'descr': '" << Type << "', 'fortran_order': "
+                                 << (FortranOrder ? "True" : "False") << ", 'shape': ("
+                                 << Rows << ", " << Width << "), }";
+
+      Header.append(63 - (10 + Header.size()) % 64, ' ');
+      Header.push_back('\n');
+
+      OS << "\x93NUMPY" << char(1) << char(0) << char(Header.size() & 0xFF) << char(Header.size() >> 8) << Header;
+    }
+
+    static void saveMatrix(const std::string &Filename, const Columns &Matrix, unsigned Width) {
+
+      std::unique_ptr<raw_fd_ostream> OS(open(Filename));
+      uint64_t Rows = Matrix.empty() ? 0 : Matrix[0].size();
+
+      writeHeader(*OS, "<i8", true, Rows, Width);
+
+      for (unsigned c = 0; c < Matrix.size(); c++)
+        for (unsigned r = 0; r < Rows; r++)
+          for (unsigned i = 0; i < 8; i++)
+            *OS << char((uint64_t)Matrix[c][r] >> (8 * i));
+    }
+
+  public:
+
+    static const unsigned FunctionWidth = 37;
+    static const unsigned LoopWidth = 36;
+    static const unsigned SimilarWidth = 3;
+
+    static const char *getFunctionColumns() {
+      return "name n_of_instructions call_freq loads stores calls cond_branches int_ops fp_ops cmp_ops cast_ops "
+             "addr_ops control_ops other_ops n_of_blocks n_of_loops n_of_params arg_bits arg_padding_bits "
+             "dyn_instructions dyn_loads dyn_stores incl_instructions incl_loads incl_stores bytes_loaded bytes_stored "
+             "dyn_arith_ops dyn_bytes_loaded dyn_bytes_stored roofline_ops roofline_bytes roofline_level footprint_read "
+             "footprint_written footprint_fallbacks profiled";
+    }
+
+    static const char *getLoopColumns() {
+      return "function block function_row depth iterations stride lcds n_of_instructions n_of_blocks loads "
+             "stores calls bytes_per_iteration frequency_x1000 dyn_instructions dyn_loads dyn_stores bytes_loaded "
+             "bytes_stored dyn_arith_ops dyn_bytes_loaded dyn_bytes_stored roofline_ops roofline_bytes roofline_level "
+             "footprint_read footprint_written footprint_fallbacks mem_lcds unknown_lcds min_distance "
+             "rec_ii res_ii ii pipeline_depth pipeline_cycles";
+    }
+
+    static const char *getSimilarColumns() {
+      return "first_row second_row similarity_x1000";
+    }
+
+    void add(const FunctionRecord &R) {
+
+      int64_t ArgBits = 0, ArgPadding = 0, NumberOfLoops = 0;
+      int64_t FunctionRow = Functions.empty() ? 0 : Functions[0].size();
+
+      for (unsigned i = 0; i < R.Params.size(); i++) {
+        ArgBits += R.Params[i].NumberOfBits;
+        ArgPadding += R.Params[i].PaddingInBits;
+      }
+
+      for (unsigned b = 0; b < R.Blocks.size(); b++) {
+        const BlockRecord &BB = R.Blocks[b];
+
+        if (!BB.HasLoop)
+          continue;
+
+        const LoopRecord &L = BB.Loop;
+        int64_t Row[LoopWidth] = {
+          (int64_t)intern(R.Name), (int64_t)intern(BB.Name), FunctionRow, L.Depth, L.Iterations, L.Stride,
+          L.LoopCarriedDeps, L.Features.NumberOfInstructions, L.NumberOfBlocks, L.Features.Loads,
+          L.Features.Stores, L.Features.Calls, (int64_t)L.BytesPerIteration, (int64_t)(BB.Frequency * 1000 + 0.5),
+          (int64_t)L.Dynamic.Instructions, (int64_t)L.Dynamic.Loads, (int64_t)L.Dynamic.Stores,
+          (int64_t)L.Features.BytesLoaded, (int64_t)L.Features.BytesStored, (int64_t)L.Dynamic.ArithmeticOps,
+          (int64_t)L.Dynamic.BytesLoaded, (int64_t)L.Dynamic.BytesStored, (int64_t)L.Roofline.ArithmeticOps,
+          (int64_t)L.Roofline.Bytes, L.Roofline.Level, (int64_t)L.Footprint.BytesRead,
+          (int64_t)L.Footprint.BytesWritten, L.Footprint.Fallbacks, L.Dependences.Carried, L.Dependences.Unknown,
+          L.Dependences.MinDistance, L.Pipeline.RecII, L.Pipeline.ResII, L.Pipeline.II, L.Pipeline.Depth,
+          (int64_t)L.Pipeline.Cycles
+        };
+
+        addRow(Loops, Row, LoopWidth);
+        NumberOfLoops++;
+      }
+
+      const BlockFeatures &F = R.Features;
+      int64_t Row[FunctionWidth] = {
+        (int64_t)intern(R.Name), F.NumberOfInstructions, R.CallFreq, F.Loads, F.Stores, F.Calls, F.CondBranches,
+        F.IntOps, F.FloatOps, F.Compares, F.Casts, F.AddressOps, F.ControlOps, F.OtherOps,
+        (int64_t)R.Blocks.size(), NumberOfLoops, (int64_t)R.Params.size(), ArgBits, ArgPadding,
+        (int64_t)R.Dynamic.Instructions, (int64_t)R.Dynamic.Loads, (int64_t)R.Dynamic.Stores,
+        (int64_t)R.Inclusive.Instructions, (int64_t)R.Inclusive.Loads, (int64_t)R.Inclusive.Stores,
+        (int64_t)F.BytesLoaded, (int64_t)F.BytesStored, (int64_t)R.Dynamic.ArithmeticOps,
+        (int64_t)R.Dynamic.BytesLoaded, (int64_t)R.Dynamic.BytesStored, (int64_t)R.Roofline.ArithmeticOps,
+        (int64_t)R.Roofline.Bytes, R.Roofline.Level, (int64_t)R.Footprint.BytesRead,
+        (int64_t)R.Footprint.BytesWritten, R.Footprint.Fallbacks, R.IsProfiled
+      };
+
+      addRow(Functions, Row, FunctionWidth);
+
+      // Functions without a sketch get an all-zero row.
+      for (unsigned i = 0; i < FSIG_SKETCH_SIZE; i++)
+        Sketches.push_back(i < R.Sketch.size() ? R.Sketch[i] : 0);
+    }
+
+    void addSimilar(const SimilarPair &Pair) {
+
+      int64_t Row[SimilarWidth] = { Pair.First, Pair.Second, (int64_t)(Pair.Similarity * 1000 + 0.5) };
+
+      addRow(Similar, Row, SimilarWidth);
+    }
+
+    void save(const std::string &Prefix) const {
+
+      saveMatrix(Prefix + ".functions.npy", Functions, FunctionWidth);
+      saveMatrix(Prefix + ".loops.npy", Loops, LoopWidth);
+      saveMatrix(Prefix + ".similar.npy", Similar, SimilarWidth);
+
+      std::unique_ptr<raw_fd_ostream> OS(open(Prefix + ".sketches.npy"));
+      writeHeader(*OS, "<u4", false, Sketches.size() / FSIG_SKETCH_SIZE, FSIG_SKETCH_SIZE);
+
+      for (unsigned s = 0; s < Sketches.size(); s++)
+        for (unsigned i = 0; i < 4; i++)
+          *OS << char(Sketches[s] >> (8 * i));
+
+      OS.reset(open(Prefix + ".strings"));
+      OS->write(Strings.data(), Strings.size());
+
+      OS.reset(open(Prefix + ".columns"));
+      *OS << "version " << FSIG_SCHEMA_VERSION << "\n"
+          << "functions " << getFunctionColumns() << "\n"
+          << "loops " << getLoopColumns() << "\n"
+          << "similar " << getSimilarColumns() << "\n";
+    }
+  };
+
+
+  // Output sink of the pass. Records go through one large buffer to the file
+  // given with -fsig-output, or to stderr, instead of one unbuffered errs()
+  // write per field. The npy format collects the records in a FeatureMatrix
+  // instead, saved under the -fsig-output prefix when the sink is destroyed.
+  //
+  class SignatureOutput {
+
+    std::unique_ptr<raw_fd_ostream> OS;
+    std::unique_ptr<FeatureMatrix> Matrix;
+    std::string Prefix;
+    SignatureFormat Format;
+
+  public:
+
+    static const size_t BufferSize = 1 << 20;
+
+    SignatureOutput(StringRef Filename, SignatureFormat Format) : Prefix(Filename), Format(Format) {
+
+      if (Format == FSIG_NPY) {
+
+        if (Filename.empty() || Filename == "-")
+          report_fatal_error("FunctionSignature: the npy format needs an output prefix");
+
+        Matrix.reset(new FeatureMatrix());
+        return;
+      }
+
+      if (Filename.empty() || Filename == "-") {
+        OS.reset(new raw_fd_ostream(2, false)); // stderr, as errs() did.
+      }
+      else {
+        std::error_code EC;
+        OS.reset(new raw_fd_ostream(Filename, EC, sys::fs::F_None));
+
+        if (EC)
+          report_fatal_error("FunctionSignature: cannot open '" + Filename + "': " + EC.message());
+      }
+
+      OS->SetBufferSize(BufferSize);
+    }
+
+    ~SignatureOutput() {
+
+      if (Matrix)
+        Matrix->save(Prefix);
+      else
+        OS->flush();
+    }
+
+    SignatureFormat getFormat() const { return Format; }
+
+    void writeHeader(StringRef ModuleName) {
+
+      if (Format != FSIG_JSON)
+        return;
+
+      *OS << "{\"schema\":\"fsig\",\"version\":" << FSIG_SCHEMA_VERSION << ",\"kind\":\"module\",\"name\":";
+      writeJSONString(*OS, ModuleName);
+      *OS << "}\n";
+    }
+
+    void write(const FunctionRecord &R) {
+
+      if (Format == FSIG_NPY)
+        Matrix->add(R);
+      else if (Format == FSIG_JSON)
+        writeJSONRecord(*OS, R);
+      else
+        writeTextRecord(*OS, R);
+    }
+
+    // S[...] record, after the records of the Module.
+    void writeSimilar(const std::vector<FunctionRecord> &Records, const SimilarPair &Pair) {
+
+      if (Format == FSIG_NPY) {
+        Matrix->addSimilar(Pair);
+        return;
+      }
+
+      if (Format == FSIG_JSON) {
+        *OS << "{\"schema\":\"fsig\",\"version\":" << FSIG_SCHEMA_VERSION << ",\"kind\":\"similar\",\"first\":";
+        writeJSONString(*OS, Records[Pair.First].Name);
+        *OS << ",\"second\":";
+        writeJSONString(*OS, Records[Pair.Second].Name);
+        *OS << ",\"similarity\":" << format("%g", Pair.Similarity) << "}\n";
+      }
+      else
+        *OS << "S[first:" << Records[Pair.First].Name << "; second:" << Records[Pair.Second].Name
+            << "; similarity:" << format("%g", Pair.Similarity) << "]\n";
+    }
+
+    void flush() {
+
+      if (OS)
+        OS->flush();
+    }
+  };
+
+} // End of namespace llvm
+
+#endif
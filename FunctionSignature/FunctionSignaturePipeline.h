@@ -0,0 +1,292 @@
+//===--------------------- FunctionSignaturePipeline.h --------------------===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the Università della Svizzera italiana (USI)
+// Open Source License.
+//
+// Author         : Georgios Zacharopoulos
+// Date Started   : April, 2019
+//
+//===----------------------------------------------------------------------===//
+//
+// Initiation interval of the innermost loops if they were software pipelined,
+// from the latencies and the ports of a table of operation classes: the
+// recurrences of a loop bound it from below, as its ports do.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef FUNCTION_SIGNATURE_PIPELINE_H
+#define FUNCTION_SIGNATURE_PIPELINE_H
+
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/ADT/StringExtras.h"
+#include "llvm/Analysis/LoopInfo.h"
+#include "llvm/Analysis/LoopIterator.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/IR/IntrinsicInst.h"
+#include "llvm/Support/LineIterator.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "FunctionSignatureOutput.h"
+#include <algorithm>
+#include <string>
+#include <vector>
+
+namespace llvm {
+
+  // Classes of operations, as named in a latency table. Address arithmetic
+  // and the casts that only change the width of a value are wires, as PHIs
+  // and branches.
+  enum OperationClass { FSIG_OP_ALU, FSIG_OP_MUL, FSIG_OP_DIV, FSIG_OP_FADD, FSIG_OP_FMUL, FSIG_OP_FDIV,
+                        FSIG_OP_LOAD, FSIG_OP_STORE, FSIG_OP_CALL, FSIG_OP_ADDR, FSIG_OP_WIRE,
+                        FSIG_NUMBER_OF_OP_CLASSES };
+
+  inline const char *getOperationClassName(OperationClass Class) {
+
+    static const char *Names[FSIG_NUMBER_OF_OP_CLASSES] = {
+      "alu", "mul", "div", "fadd", "fmul", "fdiv", "load", "store", "call", "addr", "wire"
+    };
+
+    return Names[Class];
+  }
+
+  // Latency in cycles and number of ports of every operation class; 0 ports
+  // is as many as the loop needs. The defaults are those of a typical FPGA
+  // fabric with dual-ported memories, and a file given with -fsig-latencies
+  // overrides them one class per line:
+  //
+  //   # class latency [ports]
+  //   fmul 5 2
+  //
+  class LatencyTable {
+
+    unsigned int Latency[FSIG_NUMBER_OF_OP_CLASSES];
+    unsigned int Ports[FSIG_NUMBER_OF_OP_CLASSES];
+
+    void set(OperationClass Class, unsigned int ClassLatency, unsigned int ClassPorts) {
+      Latency[Class] = ClassLatency;
+      Ports[Class] = ClassPorts;
+    }
+
+  public:
+
+    LatencyTable() {
+      set(FSIG_OP_ALU,   1,  0);
+      set(FSIG_OP_MUL,   3,  0);
+      set(FSIG_OP_DIV,   20, 1);
+      set(FSIG_OP_FADD,  4,  0);
+      set(FSIG_OP_FMUL,  3,  0);
+      set(FSIG_OP_FDIV,  12, 1);
+      set(FSIG_OP_LOAD,  2,  2);
+      set(FSIG_OP_STORE, 1,  1);
+      set(FSIG_OP_CALL,  1,  1);
+      set(FSIG_OP_ADDR,  0,  0);
+      set(FSIG_OP_WIRE,  0,  0);
+    }
+
+    bool load(StringRef Filename, std::string &Error) {
+
+      ErrorOr<std::unique_ptr<MemoryBuffer> > Buffer = MemoryBuffer::getFile(Filename);
+
+      if (std::error_code EC = Buffer.getError()) {
+        Error = EC.message();
+        return false;
+      }
+
+      for (line_iterator Line(**Buffer, true); !Line.is_at_eof(); ++Line) {
+
+        SmallVector<StringRef, 4> Fields;
+        unsigned int Class = 0, ClassLatency, ClassPorts = 0;
+
+        SplitString(Line->split('#').first, Fields);
+
+        if (Fields.empty())
+          continue;
+
+        while (Class < FSIG_NUMBER_OF_OP_CLASSES && Fields[0] != getOperationClassName((OperationClass)Class))
+          Class++;
+
+        if (Class == FSIG_NUMBER_OF_OP_CLASSES || Fields.size() < 2 || Fields.size() > 3 ||
+            Fields[1].getAsInteger(10, ClassLatency) || (Fields.size() == 3 && Fields[2].getAsInteger(10, ClassPorts))) {
+          Error = "line " + utostr(Line.line_number()) + ": expected '<class> <latency> [<ports>]'";
+          return false;
+        }
+
+        set((OperationClass)Class, ClassLatency, ClassPorts);
+      }
+
+      return true;
+    }
+
+    static OperationClass classify(const Instruction &I) {
+
+      switch (I.getOpcode()) {
+        case Instruction::Mul:           return FSIG_OP_MUL;
+        case Instruction::UDiv:
+        case Instruction::SDiv:
+        case Instruction::URem:
+        case Instruction::SRem:          return FSIG_OP_DIV;
+        case Instruction::FAdd:
+        case Instruction::FSub:
+        case Instruction::FCmp:
+        case Instruction::FPToUI:
+        case Instruction::FPToSI:
+        case Instruction::UIToFP:
+        case Instruction::SIToFP:
+        case Instruction::FPTrunc:
+        case Instruction::FPExt:         return FSIG_OP_FADD;
+        case Instruction::FMul:          return FSIG_OP_FMUL;
+        case Instruction::FDiv:
+        case Instruction::FRem:          return FSIG_OP_FDIV;
+        case Instruction::Load:          return FSIG_OP_LOAD;
+        case Instruction::Store:         return FSIG_OP_STORE;
+        case Instruction::GetElementPtr:
+        case Instruction::Alloca:        return FSIG_OP_ADDR;
+        case Instruction::PHI:
+        case Instruction::Trunc:
+        case Instruction::ZExt:
+        case Instruction::SExt:
+        case Instruction::BitCast:
+        case Instruction::PtrToInt:
+        case Instruction::IntToPtr:      return FSIG_OP_WIRE;
+        case Instruction::Call:
+        case Instruction::Invoke:        return isa<DbgInfoIntrinsic>(I) ? FSIG_OP_WIRE : FSIG_OP_CALL;
+        default:                         return I.isTerminator() ? FSIG_OP_WIRE : FSIG_OP_ALU;
+      }
+    }
+
+    unsigned int getLatency(const Instruction &I) const { return Latency[classify(I)]; }
+    unsigned int getLatency(OperationClass Class) const { return Latency[Class]; }
+    unsigned int getPorts(OperationClass Class) const { return Ports[Class]; }
+
+    // Fingerprint of the table, for the keys of the cache.
+    uint64_t hash() const {
+
+      uint64_t Hash = 0;
+
+      for (unsigned i = 0; i < FSIG_NUMBER_OF_OP_CLASSES; i++)
+        Hash = Hash * 1000003 + ((uint64_t)Latency[i] << 32 | Ports[i]);
+
+      return Hash;
+    }
+  };
+
+  // Every iteration of an innermost Loop runs its blocks in order, as after
+  // if-conversion, and each operation starts as soon as its operands inside
+  // the iteration are ready. A recurrence is a cycle through a header PHI,
+  // from the PHI to the value it takes from the latch, at distance 1, or
+  // through memory, from the sink of a flow dependence the Loop carries at a
+  // constant distance to its source, when the stored value or address
+  // depends on the loaded one. Dependences are only known in the deep tier.
+  //
+  class PipelineEstimator {
+
+    const LatencyTable &Table;
+    std::vector<const Instruction *> Body; // In reverse post order.
+
+    // Longest latency from the start of From to the end of To, through the
+    // operands within one iteration; 0 when To does not depend on From.
+    uint64_t getPathLatency(const Instruction *From, const Instruction *To) const {
+
+      DenseMap<const Instruction *, uint64_t> Finish;
+
+      Finish[From] = Table.getLatency(*From);
+
+      for (unsigned i = 0; i < Body.size(); i++) {
+
+        const Instruction *I = Body[i];
+        bool Reached = false;
+        uint64_t Start = 0;
+
+        if (I == From)
+          continue;
+
+        for (unsigned o = 0; o < I->getNumOperands(); o++) {
+          DenseMap<const Instruction *, uint64_t>::const_iterator It =
+            Finish.find(dyn_cast<Instruction>(I->getOperand(o)));
+
+          if (It != Finish.end()) {
+            Start = std::max(Start, It->second);
+            Reached = true;
+          }
+        }
+
+        if (Reached)
+          Finish[I] = Start + Table.getLatency(*I);
+      }
+
+      return Finish.lookup(To);
+    }
+
+    static unsigned int divideCeil(uint64_t Latency, uint64_t Distance) {
+      return (unsigned int)((Latency + Distance - 1) / Distance);
+    }
+
+  public:
+
+    PipelineEstimator(const LatencyTable &Table) : Table(Table) {}
+
+    PipelineRecord estimate(Loop *L, LoopInfo *LI, const LoopRecord &Summary) {
+
+      PipelineRecord Pipeline;
+      DenseMap<const Instruction *, uint64_t> Finish;
+      unsigned int Uses[FSIG_NUMBER_OF_OP_CLASSES] = { 0 };
+      LoopBlocksDFS DFS(L);
+
+      DFS.perform(LI);
+      Body.clear();
+
+      for (LoopBlocksDFS::RPOIterator BB = DFS.beginRPO(), E = DFS.endRPO(); BB != E; ++BB)
+        for(BasicBlock::iterator BI = (*BB)->begin(), BE = (*BB)->end(); BI != BE; ++BI)
+          Body.push_back(&*BI);
+
+      // The latch values of the header PHIs come after them, so that no
+      // operand across iterations is followed here.
+      for (unsigned i = 0; i < Body.size(); i++) {
+
+        const Instruction *I = Body[i];
+        uint64_t Start = 0;
+
+        for (unsigned o = 0; o < I->getNumOperands(); o++)
+          if (const Instruction *Operand = dyn_cast<Instruction>(I->getOperand(o)))
+            Start = std::max(Start, Finish.lookup(Operand));
+
+        Finish[I] = Start + Table.getLatency(*I);
+        Pipeline.Depth = std::max(Pipeline.Depth, (unsigned int)Finish[I]);
+        Uses[LatencyTable::classify(*I)]++;
+      }
+
+      for (unsigned Class = 0; Class < FSIG_NUMBER_OF_OP_CLASSES; Class++)
+        if (unsigned int Ports = Table.getPorts((OperationClass)Class))
+          Pipeline.ResII = std::max(Pipeline.ResII, divideCeil(Uses[Class], Ports));
+
+      for(BasicBlock::iterator BI = L->getHeader()->begin(); const PHINode *PHI = dyn_cast<PHINode>(&*BI); ++BI)
+        for (unsigned i = 0; i < PHI->getNumIncomingValues(); i++)
+          if (L->contains(PHI->getIncomingBlock(i)))
+            if (const Instruction *Next = dyn_cast<Instruction>(PHI->getIncomingValue(i)))
+              Pipeline.RecII = std::max(Pipeline.RecII, divideCeil(getPathLatency(PHI, Next), 1));
+
+      for (unsigned i = 0; i < Summary.Dependences.Records.size(); i++) {
+        const DependenceRecord &D = Summary.Dependences.Records[i];
+
+        if (D.Kind != FSIG_DEP_FLOW || D.Distance <= 0 || !D.SrcAddr)
+          continue;
+
+        uint64_t Latency = getPathLatency(static_cast<const Instruction *>(D.DstAddr),
+                                          static_cast<const Instruction *>(D.SrcAddr));
+
+        Pipeline.RecII = std::max(Pipeline.RecII, divideCeil(Latency, D.Distance));
+      }
+
+      Pipeline.II = std::max(std::max(Pipeline.RecII, Pipeline.ResII), 1U);
+      Pipeline.Cycles = Summary.Iterations ? (uint64_t)Summary.Iterations * Pipeline.II + Pipeline.Depth : 0;
+      Pipeline.Computed = true;
+
+      return Pipeline;
+    }
+  };
+
+} // End of namespace llvm
+
+#endif
@@ -0,0 +1,152 @@
+//===--------------------- FunctionSignatureProfile.h ---------------------===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the Università della Svizzera italiana (USI)
+// Open Source License.
+//
+// Author         : Georgios Zacharopoulos
+// Date Started   : April, 2019
+//
+//===----------------------------------------------------------------------===//
+//
+// Entry counts read straight from an indexed .profdata file and attached to
+// the Functions in memory, instead of recompiling every source with
+// -fprofile-instr-use to embed them in the IR.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef FUNCTION_SIGNATURE_PROFILE_H
+#define FUNCTION_SIGNATURE_PROFILE_H
+
+#include "llvm/ADT/StringMap.h"
+#include "llvm/IR/Function.h"
+#include "llvm/IR/Module.h"
+#include "llvm/ProfileData/InstrProfReader.h"
+#include "llvm/Support/raw_ostream.h"
+#include <atomic>
+#include <string>
+#include <vector>
+
+namespace llvm {
+
+  // Counts of every Function of a profile, by PGO name. The first counter of
+  // a clang instrumentation record is the entry count of the Function; the
+  // others count source regions and have no IR block to map to, so the block
+  // counts follow from the entry count through BlockFrequencyInfo.
+  //
+  class ProfileAnnotator {
+
+    struct Entry {
+      uint64_t Hash;
+      uint64_t Count;
+    };
+
+    StringMap<std::vector<Entry> > Entries; // Read only once loaded.
+    StringMap<const std::vector<Entry> *> Locals; // By the name after "<file>:", null if in several files.
+    std::atomic<unsigned int> Matched; // Counters, shared by the fsig -batch workers.
+    std::atomic<unsigned int> Ambiguous; // Several records of different hashes, none picked.
+    std::atomic<unsigned int> Missing;
+
+    // The record of F. Local Functions are named "<file>:<name>" by clang;
+    // the file is the Module identifier when it was compiled as is, and any
+    // single record of that name is taken otherwise.
+    const std::vector<Entry> *find(Function &F) const {
+
+      StringMap<std::vector<Entry> >::const_iterator It = Entries.find(F.getName());
+
+      if (It != Entries.end() || !F.hasLocalLinkage())
+        return It != Entries.end() ? &It->second : nullptr;
+
+      It = Entries.find(F.getParent()->getModuleIdentifier() + ":" + F.getName().str());
+
+      if (It != Entries.end())
+        return &It->second;
+
+      return Locals.lookup(F.getName());
+    }
+
+  public:
+
+    ProfileAnnotator() : Matched(0), Ambiguous(0), Missing(0) {}
+
+    bool load(StringRef Filename, std::string &Error) {
+
+      ErrorOr<std::unique_ptr<IndexedInstrProfReader> > Reader = IndexedInstrProfReader::create(Filename);
+
+      if (std::error_code EC = Reader.getError()) {
+        Error = EC.message();
+        return false;
+      }
+
+      for (InstrProfIterator It = (*Reader)->begin(), E = (*Reader)->end(); It != E; ++It) {
+        const InstrProfRecord &Record = *It;
+
+        if (Record.Counts.empty())
+          continue;
+
+        Entry Counts = { Record.Hash, Record.Counts[0] };
+        Entries[Record.Name].push_back(Counts);
+      }
+
+      if ((*Reader)->hasError()) {
+        Error = (*Reader)->getError().message();
+        return false;
+      }
+
+      for (StringMap<std::vector<Entry> >::iterator It = Entries.begin(); It != Entries.end(); ++It) {
+
+        std::pair<StringRef, StringRef> Local = It->first().rsplit(':');
+
+        if (Local.second.empty())
+          continue;
+
+        std::pair<StringMap<const std::vector<Entry> *>::iterator, bool> Inserted =
+          Locals.insert(std::make_pair(Local.second, &It->second));
+
+        if (!Inserted.second)
+          Inserted.first->second = nullptr;
+      }
+
+      return true;
+    }
+
+    // Replace the entry count of F with the one of the profile. The structural
+    // hash of clang cannot be computed again from the IR, so a name with
+    // records of several hashes is left alone rather than guessed.
+    //
+    bool annotate(Function &F) {
+
+      const std::vector<Entry> *Records = find(F);
+
+      if (!Records) {
+        Missing++;
+        return false;
+      }
+
+      for (unsigned i = 1; i < Records->size(); i++)
+        if ((*Records)[i].Hash != (*Records)[0].Hash) {
+          Ambiguous++;
+          return false;
+        }
+
+      F.setEntryCount((*Records)[0].Count);
+      Matched++;
+
+      return true;
+    }
+
+    void annotate(Module &M) {
+      for (Module::iterator F = M.begin(), E = M.end(); F != E; ++F)
+        if (!F->isDeclaration())
+          annotate(*F);
+    }
+
+    unsigned int getNumberOfMatched() const { return Matched; }
+    unsigned int getNumberOfAmbiguous() const { return Ambiguous; }
+    unsigned int getNumberOfMissing() const { return Missing; }
+  };
+
+} // End of namespace llvm
+
+#endif
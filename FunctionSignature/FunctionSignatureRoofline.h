@@ -0,0 +1,90 @@
+//===--------------------- FunctionSignatureRoofline.h --------------------===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the Università della Svizzera italiana (USI)
+// Open Source License.
+//
+// Author         : Georgios Zacharopoulos
+// Date Started   : April, 2019
+//
+//===----------------------------------------------------------------------===//
+//
+// Arithmetic intensity of the Functions and the loops of the records, and
+// their place against the balance points of a machine: below the first one
+// a region is memory bound, past the last one compute bound.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef FUNCTION_SIGNATURE_ROOFLINE_H
+#define FUNCTION_SIGNATURE_ROOFLINE_H
+
+#include "FunctionSignatureOutput.h"
+#include <algorithm>
+#include <vector>
+
+namespace llvm {
+
+  // Balance is sorted, in operations per byte. A region with no memory
+  // traffic at all is as compute bound as it gets.
+  //
+  inline void classifyRoofline(RooflineRecord &Roofline, uint64_t ArithmeticOps, uint64_t Bytes,
+                               const std::vector<double> &Balance) {
+
+    Roofline.ArithmeticOps = ArithmeticOps;
+    Roofline.Bytes = Bytes;
+    Roofline.OpsPerByte = Bytes ? (double)ArithmeticOps / Bytes : 0;
+    Roofline.Levels = Balance.size();
+    Roofline.Level = -1;
+
+    if (Balance.empty())
+      return;
+
+    Roofline.Level = 0;
+
+    for (unsigned i = 0; i < Balance.size(); i++)
+      if (!Bytes || Roofline.OpsPerByte >= Balance[i])
+        Roofline.Level++;
+  }
+
+  // Intensities of every record and of its loops. The measured counts are
+  // used when the records have them; the static ones only see one trip of
+  // each loop, so those are scaled by the trip count of the loop.
+  //
+  inline void computeRooflines(std::vector<FunctionRecord> &Records, std::vector<double> Balance) {
+
+    std::sort(Balance.begin(), Balance.end());
+
+    for (unsigned i = 0; i < Records.size(); i++) {
+      FunctionRecord &R = Records[i];
+
+      if (R.HasDynamicCounts)
+        classifyRoofline(R.Roofline, R.Dynamic.ArithmeticOps,
+                         R.Dynamic.BytesLoaded + R.Dynamic.BytesStored, Balance);
+      else
+        classifyRoofline(R.Roofline, R.Features.getArithmeticOps(),
+                         R.Features.BytesLoaded + R.Features.BytesStored, Balance);
+
+      for (unsigned b = 0; b < R.Blocks.size(); b++) {
+
+        if (!R.Blocks[b].HasLoop)
+          continue;
+
+        LoopRecord &Loop = R.Blocks[b].Loop;
+        uint64_t Trips = std::max(Loop.Iterations, 1U);
+
+        if (R.HasDynamicCounts)
+          classifyRoofline(Loop.Roofline, Loop.Dynamic.ArithmeticOps,
+                           Loop.Dynamic.BytesLoaded + Loop.Dynamic.BytesStored, Balance);
+        else
+          classifyRoofline(Loop.Roofline, Loop.Features.getArithmeticOps() * Trips,
+                           (Loop.Features.BytesLoaded + Loop.Features.BytesStored) * Trips, Balance);
+      }
+
+      R.HasRoofline = true;
+    }
+  }
+
+} // End of namespace llvm
+
+#endif
@@ -0,0 +1,233 @@
+//===--------------------- FunctionSignatureSketch.h ----------------------===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the Università della Svizzera italiana (USI)
+// Open Source License.
+//
+// Author         : Georgios Zacharopoulos
+// Date Started   : April, 2019
+//
+//===----------------------------------------------------------------------===//
+//
+// MinHash sketches of the opcode and type n-grams of a Function, and a
+// locality-sensitive hashing index over them that finds similar Functions
+// without comparing every pair.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef FUNCTION_SIGNATURE_SKETCH_H
+#define FUNCTION_SIGNATURE_SKETCH_H
+
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/DenseSet.h"
+#include "llvm/IR/InstrTypes.h"
+#include "llvm/IR/Instruction.h"
+#include "llvm/IR/Type.h"
+#include "FunctionSignatureOutput.h"
+#include <algorithm>
+#include <vector>
+
+namespace llvm {
+
+  // Finalizer of splitmix64: a cheap and well mixed 64-bit hash.
+  //
+  inline uint64_t mixSketchHash(uint64_t Value) {
+    Value += 0x9E3779B97F4A7C15ULL;
+    Value = (Value ^ (Value >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    Value = (Value ^ (Value >> 27)) * 0x94D049BB133111EBULL;
+    return Value ^ (Value >> 31);
+  }
+
+  // One-permutation MinHash over the trigrams of instruction tokens of each
+  // block. A token is the opcode and the type of the result, so the sketch
+  // follows the shape of the code and not its names. Every trigram is hashed
+  // once: the low bits pick one of the FSIG_SKETCH_SIZE bins and the minimum
+  // of the high bits is kept per bin. Empty bins borrow the value of the next
+  // non-empty one, so that the sketches of small Functions stay comparable.
+  //
+  class SketchBuilder {
+
+    static const uint64_t BlockStart = 0x5EEDULL;
+
+    uint32_t Bins[FSIG_SKETCH_SIZE];
+    uint64_t Previous[2]; // The last two tokens of the block.
+    bool Empty;
+
+  public:
+
+    SketchBuilder() { clear(); }
+
+    void clear() {
+      std::fill(Bins, Bins + FSIG_SKETCH_SIZE, ~0U);
+      Empty = true;
+      beginBlock();
+    }
+
+    // Trigrams do not span blocks; the first ones of a block are padded.
+    void beginBlock() {
+      Previous[0] = Previous[1] = BlockStart;
+    }
+
+    static uint64_t getToken(Instruction &I) {
+
+      Type *Ty = I.getType();
+      uint64_t Token = (uint64_t)I.getOpcode() << 32 | (uint64_t)Ty->getTypeID() << 24;
+
+      if (Ty->isIntOrIntVectorTy() || Ty->isFPOrFPVectorTy())
+        Token |= Ty->getScalarSizeInBits();
+
+      if (CmpInst *CI = dyn_cast<CmpInst>(&I))
+        Token |= (uint64_t)CI->getPredicate() << 16;
+
+      return Token;
+    }
+
+    void add(Instruction &I) {
+
+      uint64_t Token = getToken(I);
+      uint64_t Hash = mixSketchHash(mixSketchHash(mixSketchHash(Previous[0]) ^ Previous[1]) ^ Token);
+      unsigned Bin = Hash % FSIG_SKETCH_SIZE;
+
+      Bins[Bin] = std::min(Bins[Bin], (uint32_t)(Hash >> 32));
+      Previous[0] = Previous[1];
+      Previous[1] = Token;
+      Empty = false;
+    }
+
+    void getSketch(std::vector<uint32_t> &Sketch) const {
+
+      Sketch.assign(FSIG_SKETCH_SIZE, 0);
+
+      if (Empty)
+        return;
+
+      for (unsigned i = 0; i < FSIG_SKETCH_SIZE; i++) {
+
+        unsigned Distance = 0;
+
+        while (Bins[(i + Distance) % FSIG_SKETCH_SIZE] == ~0U)
+          Distance++;
+
+        uint32_t Value = Bins[(i + Distance) % FSIG_SKETCH_SIZE];
+
+        // Borrowed values differ from the ones of the lender bin.
+        Sketch[i] = Distance ? (uint32_t)mixSketchHash((uint64_t)Value << 8 | Distance) : Value;
+      }
+    }
+  };
+
+  // Estimated Jaccard similarity of the n-gram sets of two Functions.
+  //
+  inline double getSketchSimilarity(const std::vector<uint32_t> &A, const std::vector<uint32_t> &B) {
+
+    if (A.size() != B.size() || A.empty())
+      return 0;
+
+    unsigned Equal = 0;
+
+    for (unsigned i = 0; i < A.size(); i++)
+      Equal += A[i] == B[i];
+
+    return (double)Equal / A.size();
+  }
+
+  // Banded LSH index: a sketch is split in Bands bands of Rows values and
+  // filed under one bucket per band. Two Functions become candidates when
+  // they share a bucket, which happens with probability 1-(1-s^Rows)^Bands
+  // at similarity s; 16 bands of 4 values put the threshold near 0.5.
+  //
+  class SketchIndex {
+
+    static const unsigned Rows = 4;
+    static const unsigned Bands = FSIG_SKETCH_SIZE / Rows;
+
+    DenseMap<uint64_t, std::vector<unsigned> > Buckets;
+    std::vector<const std::vector<uint32_t> *> Sketches;
+
+    static uint64_t getBucket(const std::vector<uint32_t> &Sketch, unsigned Band) {
+
+      uint64_t Hash = Band;
+
+      for (unsigned r = 0; r < Rows; r++)
+        Hash = mixSketchHash(Hash ^ Sketch[Band * Rows + r]);
+
+      return Hash >> 2; // Clear of the empty and tombstone keys of DenseMap.
+    }
+
+  public:
+
+    // The sketch must outlive the index. Returns the id of the sketch.
+    unsigned insert(const std::vector<uint32_t> &Sketch) {
+
+      unsigned Id = Sketches.size();
+
+      Sketches.push_back(&Sketch);
+
+      if (Sketch.size() == FSIG_SKETCH_SIZE)
+        for (unsigned b = 0; b < Bands; b++)
+          Buckets[getBucket(Sketch, b)].push_back(Id);
+
+      return Id;
+    }
+
+    // Ids of the indexed sketches with an estimated similarity of at least
+    // Threshold, and that similarity.
+    void query(const std::vector<uint32_t> &Sketch, double Threshold,
+               std::vector<std::pair<unsigned, double> > &Similar) const {
+
+      DenseSet<unsigned> Seen;
+
+      if (Sketch.size() != FSIG_SKETCH_SIZE)
+        return;
+
+      for (unsigned b = 0; b < Bands; b++) {
+
+        DenseMap<uint64_t, std::vector<unsigned> >::const_iterator Bucket = Buckets.find(getBucket(Sketch, b));
+
+        if (Bucket == Buckets.end())
+          continue;
+
+        for (unsigned i = 0; i < Bucket->second.size(); i++) {
+
+          unsigned Id = Bucket->second[i];
+
+          if (!Seen.insert(Id).second)
+            continue;
+
+          double Similarity = getSketchSimilarity(Sketch, *Sketches[Id]);
+
+          if (Similarity >= Threshold)
+            Similar.push_back(std::make_pair(Id, Similarity));
+        }
+      }
+    }
+  };
+
+  // Pairs of records whose sketches are at least Threshold similar, each
+  // Function against the ones before it.
+  //
+  inline void findSimilarFunctions(const std::vector<FunctionRecord> &Records, double Threshold,
+                                   std::vector<SimilarPair> &Pairs) {
+
+    SketchIndex Index;
+
+    for (unsigned i = 0; i < Records.size(); i++) {
+
+      std::vector<std::pair<unsigned, double> > Similar;
+
+      Index.query(Records[i].Sketch, Threshold, Similar);
+      std::sort(Similar.begin(), Similar.end());
+
+      for (unsigned s = 0; s < Similar.size(); s++) {
+        SimilarPair Pair = { Similar[s].first, i, Similar[s].second };
+        Pairs.push_back(Pair);
+      }
+
+      Index.insert(Records[i].Sketch);
+    }
+  }
+
+} // End of namespace llvm
+
+#endif
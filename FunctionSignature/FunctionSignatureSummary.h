@@ -0,0 +1,132 @@
+//===--------------------- FunctionSignatureSummary.h ---------------------===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the Università della Svizzera italiana (USI)
+// Open Source License.
+//
+// Author         : Georgios Zacharopoulos
+// Date Started   : April, 2019
+//
+//===----------------------------------------------------------------------===//
+//
+// Per-translation-unit summaries: the records of one Module, saved on their
+// own, and the merge step that resolves the calls across Modules, instead of
+// linking the whole application before the analysis.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef FUNCTION_SIGNATURE_SUMMARY_H
+#define FUNCTION_SIGNATURE_SUMMARY_H
+
+#include "llvm/ADT/StringRef.h"
+#include "llvm/Support/ErrorOr.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/raw_ostream.h"
+#include "FunctionSignatureOutput.h"
+#include "FunctionSignatureCache.h"
+#include "FunctionSignatureCallGraph.h"
+#include <string>
+#include <vector>
+
+namespace llvm {
+
+  // Summaries use the encoding of the cache, and its version.
+  //
+  inline StringRef getSummaryMagic() { return "FSIGSUMMARY"; }
+
+  inline bool saveSummary(StringRef Filename, StringRef ModuleName, const std::vector<FunctionRecord> &Records,
+                          std::string &Error) {
+
+    std::error_code EC;
+    raw_fd_ostream OS(Filename, EC, sys::fs::F_None);
+
+    if (EC) {
+      Error = EC.message();
+      return false;
+    }
+
+    OS << getSummaryMagic();
+    RecordSerializer::write(OS, FSIG_CACHE_VERSION);
+    RecordSerializer::write(OS, ModuleName);
+    RecordSerializer::write(OS, Records.size());
+
+    for (unsigned i = 0; i < Records.size(); i++)
+      RecordSerializer::write(OS, Records[i]);
+
+    return true;
+  }
+
+  // Append the records of a summary to Records.
+  //
+  inline bool loadSummary(StringRef Filename, std::string &ModuleName, std::vector<FunctionRecord> &Records,
+                          std::string &Error) {
+
+    ErrorOr<std::unique_ptr<MemoryBuffer>> File = MemoryBuffer::getFile(Filename);
+
+    if (!File) {
+      Error = File.getError().message();
+      return false;
+    }
+
+    RecordSerializer::Reader In((*File)->getBuffer());
+
+    if (!In.Buffer.startswith(getSummaryMagic())) {
+      Error = "not a FunctionSignature summary";
+      return false;
+    }
+
+    In.Buffer = In.Buffer.drop_front(getSummaryMagic().size());
+
+    if (In.read() != FSIG_CACHE_VERSION) {
+      Error = "summary written by another version";
+      return false;
+    }
+
+    In.read(ModuleName);
+
+    uint64_t Count = In.readCount();
+    size_t First = Records.size();
+
+    for (uint64_t i = 0; i < Count && !In.Error; i++) {
+      Records.push_back(FunctionRecord());
+      In.read(Records.back());
+    }
+
+    if (In.Error) {
+      Records.resize(First);
+      Error = "corrupt summary";
+      return false;
+    }
+
+    return true;
+  }
+
+  // Resolve the calls of the merged records, Units giving the summary of each
+  // one. A callee that was only declared in the Module of its caller gets the
+  // instruction count of its definition in another Module; the inclusive costs
+  // are then computed over the whole program.
+  //
+  inline void mergeSummaries(std::vector<FunctionRecord> &Records, const std::vector<unsigned int> &Units) {
+
+    RecordCallGraph Graph(Records, &Units);
+
+    for (unsigned i = 0; i < Records.size(); i++)
+      for (unsigned b = 0; b < Records[i].Blocks.size(); b++) {
+        std::vector<CallRecord> &Calls = Records[i].Blocks[b].Calls;
+
+        for (unsigned c = 0; c < Calls.size(); c++) {
+          RecordCallGraph::Node *Callee = Graph.resolve(Graph.Nodes[i + 1], Calls[c].Name);
+
+          if (Callee && Callee->Unit != Units[i])
+            Calls[c].NumberOfInstructions = Callee->Record->Features.NumberOfInstructions;
+        }
+      }
+
+    computeInclusiveCosts(Records, &Units);
+  }
+
+} // End of namespace llvm
+
+#endif
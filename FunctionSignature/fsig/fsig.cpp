@@ -0,0 +1,609 @@
+//===------------------------------- fsig.cpp -------------------------------===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the Università della Svizzera italiana (USI)
+// Open Source License.
+//
+// Author         : Georgios Zacharopoulos
+// Date Started   : April, 2019
+//
+//===----------------------------------------------------------------------===//
+//
+// Standalone driver of FunctionSignature. The bitcode file is memory-mapped
+// and read lazily: every Function is materialized, promoted with mem2reg,
+// analyzed and then deleted again, so that the peak memory follows the
+// largest Function instead of the whole program. Textual IR is parsed as a
+// whole and analyzed the same way.
+//
+// With -batch the driver analyzes a whole corpus of IR and bitcode files, one
+// Module per task on a thread pool, and streams every Module into the same
+// output as soon as it is done.
+//
+// With -emit-summary every translation unit is analyzed on its own and saved
+// as a summary; -merge then resolves the calls between the summaries, so that
+// the application does not have to be linked into one Module first.
+//
+//===----------------------------------------------------------------------===//
+
+#include "llvm/Analysis/AssumptionCache.h"
+#include "llvm/Analysis/LoopInfo.h"
+#include "llvm/Analysis/ScalarEvolution.h"
+#include "llvm/Analysis/TargetLibraryInfo.h"
+#include "llvm/ADT/Triple.h"
+#include "llvm/Bitcode/ReaderWriter.h"
+#include "llvm/IR/Dominators.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/IR/LegacyPassManager.h"
+#include "llvm/IR/LLVMContext.h"
+#include "llvm/IR/Module.h"
+#include "llvm/IR/PassManager.h"
+#include "llvm/IRReader/IRReader.h"
+#include "llvm/InitializePasses.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/ManagedStatic.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/PrettyStackTrace.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/Path.h"
+#include "llvm/Support/Signals.h"
+#include "llvm/Support/SourceMgr.h"
+#include "llvm/Support/ThreadPool.h"
+#include "llvm/Support/raw_ostream.h"
+#include "llvm/Transforms/Utils/PromoteMemToReg.h"
+#include "../FunctionSignature.h"
+#include "../FunctionSignatureOutput.h"
+#include "../FunctionSignatureAnalyzer.h"
+#include "../FunctionSignatureCache.h"
+#include "../FunctionSignatureAnalysis.h"
+#include "../FunctionSignatureCallGraph.h"
+#include "../FunctionSignatureDependence.h"
+#include "../FunctionSignatureSketch.h"
+#include "../FunctionSignatureSummary.h"
+#include "../FunctionSignaturePipeline.h"
+#include "../FunctionSignatureProfile.h"
+#include "../FunctionSignatureRoofline.h"
+#include <algorithm>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+using namespace llvm;
+
+char LoopDependencePass::ID = 0;
+
+static cl::list<std::string> InputFilenames(cl::Positional,
+  cl::desc("<input bitcode or IR file, or summaries with -merge>"));
+
+static cl::opt<std::string> OutputFilename("o",
+  cl::desc("Write the FunctionSignature records to <file> (default: stderr)"),
+  cl::value_desc("file"), cl::init("-"));
+
+static cl::opt<SignatureFormat> OutputFormat("fsig-format",
+  cl::desc("Format of the FunctionSignature records"), cl::init(FSIG_TEXT),
+  cl::values(
+    clEnumValN(FSIG_TEXT, "text", "Legacy F[...] text records"),
+    clEnumValN(FSIG_JSON, "json", "Versioned JSON lines, one Function per line"),
+    clEnumValN(FSIG_NPY, "npy", "Columnar int64 feature matrices, saved under the output prefix"),
+    clEnumValEnd));
+
+static cl::opt<AnalysisLevel> Level("fsig-level",
+  cl::desc("Analysis tier of FunctionSignature"), cl::init(FSIG_STANDARD),
+  cl::values(
+    clEnumValN(FSIG_CHEAP, "cheap", "Instruction counts and signatures only"),
+    clEnumValN(FSIG_STANDARD, "standard", "Add loops and SCEV"),
+    clEnumValN(FSIG_DEEP, "deep", "Add dependence distances and memory access patterns"),
+    clEnumValEnd));
+
+static cl::opt<std::string> CacheFilename("fsig-cache",
+  cl::desc("Reuse the records of unchanged Functions from <file>, and update it"),
+  cl::value_desc("file"));
+
+static cl::opt<std::string> ProfileFilename("fsig-profile",
+  cl::desc("Take the entry counts of the Functions from an indexed <file>.profdata"),
+  cl::value_desc("file"));
+
+static cl::opt<std::string> BatchInput("batch",
+  cl::desc("Analyze every .ll, .ir and .bc file under <dir>, or listed in <manifest>, one per line"),
+  cl::value_desc("dir|manifest"));
+
+static cl::opt<bool> EmitSummary("emit-summary",
+  cl::desc("Save the records as a summary to -o, or next to each -batch input as <file>.fsum"));
+
+static cl::opt<bool> Merge("merge",
+  cl::desc("Merge the summaries given as inputs, resolving the calls between them"));
+
+static cl::opt<unsigned> Threads("fsig-threads",
+  cl::desc("Worker threads of -batch (0: one per core)"),
+  cl::init(0));
+
+static cl::list<double> Balance("fsig-balance",
+  cl::desc("Machine balance points in operations per byte, to classify the roofline bound of Functions and loops"),
+  cl::CommaSeparated, cl::value_desc("ops/byte,..."));
+
+static cl::opt<std::string> LatencyFilename("fsig-latencies",
+  cl::desc("Estimate the initiation intervals of innermost loops with the latencies and ports of <file>"),
+  cl::value_desc("file"));
+
+// Latency table of -fsig-latencies, or the defaults without it. Read only
+// once loaded, by all the -batch workers.
+static LatencyTable Latencies;
+
+static cl::opt<double> SimilarityThreshold("fsig-similarity",
+  cl::desc("Report the pairs of Functions whose MinHash sketches are at least this similar (0: off)"),
+  cl::init(0));
+
+// S[...] records of the similar Functions of the Module, found through the
+// LSH index of their sketches.
+//
+static void writeSimilarFunctions(SignatureOutput &Output, const std::vector<FunctionRecord> &Records) {
+
+  std::vector<SimilarPair> Pairs;
+
+  if (SimilarityThreshold <= 0)
+    return;
+
+  findSimilarFunctions(Records, SimilarityThreshold, Pairs);
+
+  for (unsigned i = 0; i < Pairs.size(); i++)
+    Output.writeSimilar(Records, Pairs[i]);
+}
+
+// Same promotion as the mem2reg pass.
+//
+static void promoteMemoryToRegister(Function &F) {
+
+  std::vector<AllocaInst *> Allocas;
+  BasicBlock &BB = F.getEntryBlock();
+  DominatorTree DT(F);
+  AssumptionCache AC(F);
+
+  while (1) {
+    Allocas.clear();
+
+    for (BasicBlock::iterator I = BB.begin(), E = --BB.end(); I != E; ++I)
+      if (AllocaInst *AI = dyn_cast<AllocaInst>(I))
+        if (isAllocaPromotable(AI))
+          Allocas.push_back(AI);
+
+    if (Allocas.empty())
+      break;
+
+    PromoteMemToReg(Allocas, DT, nullptr, &AC);
+  }
+}
+
+// Count the callees of F that have not been materialized yet. opt counts such
+// a callee before mem2reg runs on it, so its body is read from a second lazy
+// Module, counted and deleted again, instead of being kept in memory.
+//
+static void countCallees(Function &F, Module *Callees, SignatureRegistry &Registry) {
+
+  if (!Callees)
+    return;
+
+  for(Function::iterator BB = F.begin(), E = F.end(); BB != E; ++BB)
+    for(BasicBlock::iterator BI = BB->begin(), BE = BB->end(); BI != BE; ++BI)
+      if (CallInst *CI = dyn_cast<CallInst>(&*BI)) {
+
+        Function *Callee = CI->getCalledFunction();
+
+        if (!Callee || !Callee->isMaterializable() || Registry.hasFunction(Callee))
+          continue;
+
+        Function *Copy = Callees->getFunction(Callee->getName());
+
+        if (Copy && !Copy->materialize()) {
+          Registry.setNumberOfInstructions(Callee, SignatureRegistry::countInstructions(Copy));
+          Copy->deleteBody();
+        }
+      }
+}
+
+// Analyze one Module, from its bitcode or textual IR. The Cache and the
+// Profile are shared by the -batch workers; CacheLock guards the updates of
+// the Cache.
+//
+static bool analyzeModule(std::unique_ptr<MemoryBuffer> Buffer, LLVMContext &Context, SignatureCache &Cache,
+                          std::mutex &CacheLock, ProfileAnnotator *Profile, std::vector<FunctionRecord> &Records,
+                          std::string &ModuleName, std::string &Error) {
+
+  const unsigned char *Start = (const unsigned char *)Buffer->getBufferStart();
+  const unsigned char *End = (const unsigned char *)Buffer->getBufferEnd();
+  std::unique_ptr<Module> M;
+  std::unique_ptr<Module> Callees; // Second lazy view of the bitcode, for countCallees.
+
+  if (isBitcode(Start, End)) {
+
+    // Both Modules read the same mapping; only the first one owns it.
+    std::unique_ptr<MemoryBuffer> View = MemoryBuffer::getMemBuffer(Buffer->getMemBufferRef(), false);
+    ErrorOr<std::unique_ptr<Module>> Lazy = getLazyBitcodeModule(std::move(Buffer), Context);
+    ErrorOr<std::unique_ptr<Module>> LazyCallees = getLazyBitcodeModule(std::move(View), Context, true);
+
+    if (std::error_code EC = Lazy.getError()) {
+      Error = EC.message();
+      return false;
+    }
+
+    M = std::move(*Lazy);
+
+    if (LazyCallees)
+      Callees = std::move(*LazyCallees);
+  }
+  else {
+
+    SMDiagnostic Err;
+    M = parseIR(Buffer->getMemBufferRef(), Err, Context);
+
+    if (!M) {
+      raw_string_ostream OS(Error);
+      Err.print(nullptr, OS, false);
+      return false;
+    }
+  }
+
+  std::shared_ptr<SignatureRegistry> Registry = std::make_shared<SignatureRegistry>();
+  std::shared_ptr<TypeSizeCache> Types = std::make_shared<TypeSizeCache>(M->getDataLayout());
+  FunctionAnalysisManager FAM;
+
+  // DependenceAnalysis only runs under the legacy pass manager, in the deep
+  // tier. The pass manager owns the pass, which keeps the map of the last
+  // Function it ran on.
+  std::unique_ptr<legacy::FunctionPassManager> DependencePasses;
+  LoopDependencePass *Dependences = nullptr;
+
+  if (Level >= FSIG_DEEP) {
+    Dependences = new LoopDependencePass();
+    DependencePasses.reset(new legacy::FunctionPassManager(M.get()));
+    DependencePasses->add(Dependences);
+    DependencePasses->doInitialization();
+  }
+
+  FAM.registerPass(DominatorTreeAnalysis());
+  FAM.registerPass(LoopAnalysis());
+  FAM.registerPass(AssumptionAnalysis());
+  FAM.registerPass(TargetLibraryAnalysis(TargetLibraryInfoImpl(Triple(M->getTargetTriple()))));
+  FAM.registerPass(ScalarEvolutionAnalysis());
+  FAM.registerPass(FunctionSignatureAnalysis(Registry, Types, Level, Dependences ? &Dependences->getLoops() : nullptr,
+                                             &Latencies));
+
+  ModuleName = M->getModuleIdentifier();
+
+  for (Module::iterator F = M->begin(), E = M->end(); F != E; ++F) {
+
+    if (F->isDeclaration())
+      continue;
+
+    if (std::error_code EC = F->materialize()) {
+      Error = F->getName().str() + ": " + EC.message();
+
+      if (DependencePasses)
+        DependencePasses->doFinalization();
+
+      return false;
+    }
+
+    // The entry count feeds the hash of the cache and BlockFrequencyInfo.
+    if (Profile)
+      Profile->annotate(*F);
+
+    promoteMemoryToRegister(*F);
+    countCallees(*F, Callees.get(), *Registry);
+
+    FunctionRecord Record;
+    uint64_t Key = 0;
+    const FunctionRecord *Cached = nullptr;
+
+    if (!CacheFilename.empty()) {
+      Key = FunctionHasher().hash(*F, Level, *Registry, Latencies.hash());
+      Cached = Cache.lookup(Key);
+    }
+
+    if (Cached) {
+      Record = *Cached;
+      FunctionSignatureAnalyzer(*Registry, *Types).relink(*F, Record);
+      Registry->setNumberOfInstructions(&*F, Record.Features.NumberOfInstructions);
+    }
+    else {
+      if (DependencePasses)
+        DependencePasses->run(*F);
+
+      Record = FAM.getResult<FunctionSignatureAnalysis>(*F).getRecord();
+    }
+
+    if (!CacheFilename.empty()) {
+      std::lock_guard<std::mutex> Lock(CacheLock);
+      Cache.insert(Key, Record);
+    }
+
+    Records.push_back(std::move(Record));
+
+    // The Registry keeps the instruction count of F for its callers.
+    FAM.invalidate(*F, PreservedAnalyses::none());
+    F->deleteBody();
+  }
+
+  if (DependencePasses)
+    DependencePasses->doFinalization();
+
+  computeInclusiveCosts(Records);
+  computeRooflines(Records, Balance);
+
+  return true;
+}
+
+// Input files of -batch: the IR and bitcode files under a directory, or the
+// files listed in a manifest. The largest come first, so that the pool does
+// not end on one big Module while the other threads are idle.
+//
+static bool collectBatchInputs(StringRef Input, std::vector<std::string> &Files) {
+
+  if (sys::fs::is_directory(Input)) {
+
+    std::error_code EC;
+
+    for (sys::fs::recursive_directory_iterator It(Input, EC), End; It != End && !EC; It.increment(EC)) {
+
+      StringRef Extension = sys::path::extension(It->path());
+
+      if ((Extension == ".ll" || Extension == ".ir" || Extension == ".bc") && sys::fs::is_regular_file(It->path()))
+        Files.push_back(It->path());
+    }
+
+    if (EC)
+      return false;
+  }
+  else {
+
+    ErrorOr<std::unique_ptr<MemoryBuffer>> Manifest = MemoryBuffer::getFile(Input);
+
+    if (!Manifest)
+      return false;
+
+    SmallVector<StringRef, 64> Lines;
+    (*Manifest)->getBuffer().split(Lines, '\n', -1, false);
+
+    for (unsigned i = 0; i < Lines.size(); i++) {
+      StringRef Line = Lines[i].trim();
+
+      if (!Line.empty() && !Line.startswith("#"))
+        Files.push_back(Line);
+    }
+  }
+
+  std::vector<std::pair<uint64_t, std::string> > Sized;
+
+  for (unsigned i = 0; i < Files.size(); i++) {
+    uint64_t Size = 0;
+    sys::fs::file_size(Files[i], Size);
+    Sized.push_back(std::make_pair(Size, Files[i]));
+  }
+
+  std::stable_sort(Sized.begin(), Sized.end(),
+                   [](const std::pair<uint64_t, std::string> &A, const std::pair<uint64_t, std::string> &B) {
+                     return A.first > B.first;
+                   });
+
+  for (unsigned i = 0; i < Sized.size(); i++)
+    Files[i] = Sized[i].second;
+
+  return true;
+}
+
+// Analyze every file of -batch on a thread pool, each Module in its own
+// LLVMContext. The records of a Module are written as soon as it is done,
+// and the similar Functions are searched over the whole corpus at the end.
+// With -emit-summary each Module is saved to its own summary instead.
+//
+static int runBatch(const char *Argv0, SignatureOutput *Output, SignatureCache &Cache, ProfileAnnotator *Profile) {
+
+  std::vector<std::string> Files;
+  std::vector<FunctionRecord> Sketches; // Name and sketch of every written record, in output order.
+  std::mutex CacheLock, OutputLock;
+  bool Failed = false;
+
+  if (!collectBatchInputs(BatchInput, Files)) {
+    errs() << Argv0 << ": " << BatchInput << ": cannot read the batch input\n";
+    return 1;
+  }
+
+  {
+    // hardware_concurrency() is 0 when it is not known, and a pool without threads never runs.
+    ThreadPool Pool(Threads ? Threads : std::max(1u, std::thread::hardware_concurrency()));
+
+    for (unsigned i = 0; i < Files.size(); i++)
+      Pool.async([&, i]() {
+
+        LLVMContext Context;
+        std::vector<FunctionRecord> Records;
+        std::string ModuleName, Error;
+        ErrorOr<std::unique_ptr<MemoryBuffer>> Buffer = MemoryBuffer::getFile(Files[i]);
+
+        if (!Buffer)
+          Error = Buffer.getError().message();
+        else if (analyzeModule(std::move(*Buffer), Context, Cache, CacheLock, Profile, Records, ModuleName, Error)) {
+
+          if (!Output) {
+            if (saveSummary(Files[i] + ".fsum", ModuleName, Records, Error))
+              return;
+          }
+          else {
+            std::lock_guard<std::mutex> Lock(OutputLock);
+
+            Output->writeHeader(ModuleName);
+
+            for (unsigned r = 0; r < Records.size(); r++) {
+              Output->write(Records[r]);
+
+              Sketches.push_back(FunctionRecord());
+              Sketches.back().Name = Records[r].Name;
+              Sketches.back().Sketch.swap(Records[r].Sketch);
+            }
+
+            return;
+          }
+        }
+
+        std::lock_guard<std::mutex> Lock(OutputLock);
+        errs() << Argv0 << ": " << Files[i] << ": " << Error << "\n";
+        Failed = true;
+      });
+
+    Pool.wait();
+  }
+
+  if (Output)
+    writeSimilarFunctions(*Output, Sketches);
+
+  return Failed;
+}
+
+// Merge the summaries given as inputs and write their records, each summary
+// after its own "module" record.
+//
+static int runMerge(const char *Argv0, SignatureOutput &Output) {
+
+  std::vector<FunctionRecord> Records;
+  std::vector<unsigned int> Units; // Summary of every record.
+  std::vector<std::string> ModuleNames;
+
+  for (unsigned i = 0; i < InputFilenames.size(); i++) {
+
+    std::string ModuleName, Error;
+
+    if (!loadSummary(InputFilenames[i], ModuleName, Records, Error)) {
+      errs() << Argv0 << ": " << InputFilenames[i] << ": " << Error << "\n";
+      return 1;
+    }
+
+    ModuleNames.push_back(ModuleName);
+    Units.resize(Records.size(), i);
+  }
+
+  mergeSummaries(Records, Units);
+  computeRooflines(Records, Balance);
+
+  for (unsigned i = 0; i < Records.size(); i++) {
+
+    if (!i || Units[i] != Units[i - 1])
+      Output.writeHeader(ModuleNames[Units[i]]);
+
+    Output.write(Records[i]);
+  }
+
+  writeSimilarFunctions(Output, Records);
+
+  return 0;
+}
+
+int main(int argc, char **argv) {
+
+  sys::PrintStackTraceOnErrorSignal();
+  PrettyStackTraceProgram X(argc, argv);
+  llvm_shutdown_obj Y;
+
+  // The passes DependenceAnalysis depends on are looked up in the registry.
+  PassRegistry &Registry = *PassRegistry::getPassRegistry();
+  initializeCore(Registry);
+  initializeAnalysis(Registry);
+
+  cl::ParseCommandLineOptions(argc, argv, "FunctionSignature analysis driver\n");
+
+  std::unique_ptr<SignatureOutput> Output; // None when only summaries are saved.
+  std::unique_ptr<ProfileAnnotator> Profile; // With -fsig-profile.
+  SignatureCache Cache;
+  std::mutex CacheLock;
+  int Result = 0;
+
+  if (!Merge && InputFilenames.size() > 1) {
+    errs() << argv[0] << ": more than one input; use -batch or -merge\n";
+    return 1;
+  }
+
+  // A summary holds a single Module, and the merged records span several.
+  if (Merge && EmitSummary) {
+    errs() << argv[0] << ": -merge writes records, not a summary; drop -emit-summary\n";
+    return 1;
+  }
+
+  if (EmitSummary && BatchInput.empty() && (OutputFilename.empty() || OutputFilename == "-")) {
+    errs() << argv[0] << ": -emit-summary needs -o <file>\n";
+    return 1;
+  }
+
+  if (!EmitSummary)
+    Output.reset(new SignatureOutput(OutputFilename, OutputFormat));
+
+  if (Merge)
+    return runMerge(argv[0], *Output);
+
+  if (!CacheFilename.empty())
+    Cache.load(CacheFilename);
+
+  if (!ProfileFilename.empty()) {
+
+    std::string Error;
+    Profile.reset(new ProfileAnnotator());
+
+    if (!Profile->load(ProfileFilename, Error)) {
+      errs() << argv[0] << ": " << ProfileFilename << ": " << Error << "\n";
+      return 1;
+    }
+  }
+
+  if (!LatencyFilename.empty()) {
+
+    std::string Error;
+
+    if (!Latencies.load(LatencyFilename, Error)) {
+      errs() << argv[0] << ": " << LatencyFilename << ": " << Error << "\n";
+      return 1;
+    }
+  }
+
+  if (!BatchInput.empty())
+    Result = runBatch(argv[0], Output.get(), Cache, Profile.get());
+  else {
+
+    LLVMContext Context;
+    std::vector<FunctionRecord> Records; // Written once their inclusive costs are known.
+    std::string InputFilename = InputFilenames.empty() ? "-" : InputFilenames[0];
+    std::string ModuleName, Error;
+    ErrorOr<std::unique_ptr<MemoryBuffer>> Buffer = MemoryBuffer::getFileOrSTDIN(InputFilename);
+
+    if (std::error_code EC = Buffer.getError()) {
+      errs() << argv[0] << ": " << InputFilename << ": " << EC.message() << "\n";
+      return 1;
+    }
+
+    if (!analyzeModule(std::move(*Buffer), Context, Cache, CacheLock, Profile.get(), Records, ModuleName, Error)) {
+      errs() << argv[0] << ": " << InputFilename << ": " << Error << "\n";
+      return 1;
+    }
+
+    if (EmitSummary) {
+      if (!saveSummary(OutputFilename, ModuleName, Records, Error)) {
+        errs() << argv[0] << ": " << OutputFilename << ": " << Error << "\n";
+        return 1;
+      }
+    }
+    else {
+      Output->writeHeader(ModuleName);
+
+      for (unsigned i = 0; i < Records.size(); i++)
+        Output->write(Records[i]);
+
+      writeSimilarFunctions(*Output, Records);
+    }
+  }
+
+  if (!CacheFilename.empty())
+    Cache.save(CacheFilename);
+
+  if (Profile && (Profile->getNumberOfAmbiguous() || Profile->getNumberOfMissing()))
+    errs() << argv[0] << ": " << ProfileFilename << ": no entry count for " << Profile->getNumberOfMissing()
+           << " functions, ambiguous for " << Profile->getNumberOfAmbiguous() << "\n";
+
+  return Result;
+}
@@ -24,13 +24,19 @@ LIB_DIR_LLVM=~giorgio/llvm_new/build/lib
 #echo "--> 1. Create LLVM-IR from C"
 #for i in `ls src_$BENCH/*.c`; do  $BIN_DIR_LLVM/clang -O1 -g -S -emit-llvm $i -o $i.ir; done
 
-rm *.app.ir
-mkdir IR; mv  *.ir IR/.
+# The bitcode of "make profile" is read as is; set TEXT_IR=1 to also get the
+# linked module as textual IR ($BENCH.app.ir), for debugging.
+rm -f *.app.bc *.app.ir
+mkdir -p BC; mv  *.bc BC/.
 
-echo "--> 2. Link the LLVM-IR to a single ir file"
+echo "--> 2. Link the LLVM bitcode to a single bc file"
 #$BIN_DIR_LLVM/llvm-link -S  *.ir -o $BENCH.app.ir
-$BIN_DIR_LLVM/llvm-link -S  IR/*.ir -o $BENCH.app.ir
+$BIN_DIR_LLVM/llvm-link  BC/*.bc -o $BENCH.app.bc
+
+if [ "$TEXT_IR" = 1 ]; then $BIN_DIR_LLVM/llvm-dis $BENCH.app.bc -o $BENCH.app.ir; fi
 
 echo "--> 4. Load the FunctionSignature Pass"
-$BIN_DIR_LLVM/opt -load $LIB_DIR_LLVM/FunctionSignature.so -mem2reg  -FunctionSignature -stats    > /dev/null  $BENCH.app.ir
+# Set PROFDATA=$BENCH.profdata to read the entry counts from the profile
+# instead of the annotation of "make profile" (see "make bitcode").
+$BIN_DIR_LLVM/opt -load $LIB_DIR_LLVM/FunctionSignature.so -mem2reg  -FunctionSignature -stats ${PROFDATA:+-fsig-profile=$PROFDATA}   > /dev/null  $BENCH.app.bc
 #$BIN_DIR_LLVM/opt -load $LIB_DIR_LLVM/FunctionSignature.so -FunctionSignature -stats    > /dev/null  $BENCH.ir
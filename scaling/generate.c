@@ -0,0 +1,95 @@
+/*
+ * Synthetic input generator for the FunctionSignature scalability benchmark.
+ *
+ * Writes a C module to stdout with:
+ *   - <functions> functions,
+ *   - a loop nest <depth> deep in each of them,
+ *   - one straight-line basic block of <block> statements per function,
+ *   - a struct of <fields> members passed by value and by pointer,
+ *   - calls to the next <fanout> functions from each of them.
+ *
+ * The module is turned into bitcode with clang -c -emit-llvm, as the benchmarks.
+ *
+ *    Georgios Zacharopoulos <georgios@seas.harvard.edu>
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+
+static const char *field_types[] = { "int", "double", "char" };
+
+static void usage(const char *name) {
+    fprintf(stderr, "usage: %s <functions> <depth> <block> <fields> <fanout>\n", name);
+    exit(1);
+}
+
+static void print_signature(int f) {
+    printf("int f%d(struct big_t s, struct big_t *p, int n)", f);
+}
+
+int main( int argc, const char* argv[] ){
+    int functions, depth, block, fields, fanout;
+    int f, i, j;
+
+    if (argc != 6)
+        usage(argv[0]);
+
+    functions = atoi(argv[1]);
+    depth     = atoi(argv[2]);
+    block     = atoi(argv[3]);
+    fields    = atoi(argv[4]);
+    fanout    = atoi(argv[5]);
+
+    if (functions < 1 || depth < 0 || block < 0 || fields < 1 || fanout < 0)
+        usage(argv[0]);
+
+    /* Struct argument, with padding between the members. */
+    printf("struct big_t {\n");
+    for (i = 0; i < fields; i++)
+        printf("    %s m%d;\n", field_types[i % 3], i);
+    printf("};\n\n");
+
+    for (f = 0; f < functions; f++) {
+        print_signature(f);
+        printf(";\n");
+    }
+    printf("\n");
+
+    for (f = 0; f < functions; f++) {
+        print_signature(f);
+        printf(" {\n");
+        printf("    int acc = %d;\n", f);
+
+        for (i = 0; i < depth; i++)
+            printf("    int i%d;\n", i);
+
+        /* Loop nest, with a strided access in the innermost body. */
+        for (i = 0; i < depth; i++)
+            printf("%*sfor (i%d = 0; i%d < n; i%d++)\n", 4 * (i + 1), "", i, i, i);
+
+        if (depth)
+            printf("%*sacc += (int)p[i%d].m%d * i0;\n", 4 * (depth + 1), "", depth - 1, f % fields);
+
+        /* Huge basic block. */
+        for (i = 0; i < block; i++)
+            printf("    acc = acc * %d + (int)p->m%d - (int)s.m%d;\n", i % 7 + 2, i % fields, (i * 3) % fields);
+
+        /* Call fan-out, to later functions only. */
+        if (fanout && f + 1 < functions) {
+            printf("    if (n > 0) {\n");
+            for (j = 1; j <= fanout && f + j < functions; j++)
+                printf("        acc += f%d(s, p, n - 1);\n", f + j);
+            printf("    }\n");
+        }
+
+        printf("    return acc;\n");
+        printf("}\n\n");
+    }
+
+    printf("int main(void) {\n");
+    printf("    struct big_t s = { 0 };\n");
+    printf("    return f0(s, &s, 1);\n");
+    printf("}\n");
+
+    return 0;
+}
@@ -0,0 +1,101 @@
+############### Scalability benchmark of the FunctionSignature analysis ##############
+#
+#  Generates synthetic modules of growing size along one axis at a time
+#  (functions, loop depth, basic block size, struct fields, call fan-out),
+#  runs the analysis on each of them and reports the analysis time, the time
+#  per instruction and the peak RSS. A sweep whose time per instruction grows
+#  more than SUPERLINEAR_RATIO times from its smallest to its largest module
+#  is reported as superlinear, and the script then exits with status 1.
+#
+#    Georgios Zacharopoulos <georgios@seas.harvard.edu>
+############################################################################################### 
+
+#!/bin/bash
+
+# Paths to LLVM-3.8 (Edit the Path)
+BIN_DIR_LLVM=${BIN_DIR_LLVM:-~/FunctionSignature/llvm-3.8.0/build/bin}
+LIB_DIR_LLVM=${LIB_DIR_LLVM:-~/FunctionSignature/llvm-3.8.0/build/lib}
+
+# Driver under test: opt (FunctionSignature), parallel (FunctionSignatureParallel) or fsig.
+DRIVER=${DRIVER:-opt}
+LEVEL=${LEVEL:-standard}
+SUPERLINEAR_RATIO=${SUPERLINEAR_RATIO:-3}
+RESULTS=${RESULTS:-results.csv}
+WORK=${WORK:-work}
+TIME=${TIME:-/usr/bin/time} # GNU time, for the peak RSS.
+
+# Defaults of the axes that are not being swept.
+FUNCTIONS=100
+DEPTH=2
+BLOCK=50
+FIELDS=8
+FANOUT=2
+
+mkdir -p $WORK
+echo "axis,functions,depth,block,fields,fanout,instructions,seconds,us_per_instruction,peak_rss_kb" > $RESULTS
+STATUS=0
+
+# Analyze one module and append its row to $RESULTS.
+run() {
+  AXIS=$1
+  NAME=$WORK/$AXIS.$2
+  ./generate $FUNCTIONS $DEPTH $BLOCK $FIELDS $FANOUT > $NAME.c || exit 1
+  $BIN_DIR_LLVM/clang -c -emit-llvm -O0 -o $NAME.bc $NAME.c || exit 1
+
+  case $DRIVER in
+    opt)      CMD="$BIN_DIR_LLVM/opt -load $LIB_DIR_LLVM/FunctionSignature.so -mem2reg -FunctionSignature -o /dev/null" ;;
+    parallel) CMD="$BIN_DIR_LLVM/opt -load $LIB_DIR_LLVM/FunctionSignature.so -mem2reg -FunctionSignatureParallel -o /dev/null" ;;
+    fsig)     CMD="$BIN_DIR_LLVM/fsig" ;;
+  esac
+
+  if [ $DRIVER = fsig ]; then
+    $TIME -f "%e %M" -o $NAME.time $CMD -fsig-level=$LEVEL -fsig-format=json -o $NAME.json $NAME.bc || exit 1
+  else
+    $TIME -f "%e %M" -o $NAME.time $CMD -fsig-level=$LEVEL -fsig-format=json -fsig-output=$NAME.json $NAME.bc || exit 1
+  fi
+
+  # The first n_of_instructions of a function record is its own, whatever
+  # the order of the fields before it; the blocks and loops follow.
+  INSTRUCTIONS=`awk '/"kind":"function"/ && match($0, /"n_of_instructions":[0-9]+/) { n += substr($0, RSTART + 20, RLENGTH - 20) } END { print n + 0 }' $NAME.json`
+
+  if [ -z "$INSTRUCTIONS" ] || [ "$INSTRUCTIONS" -eq 0 ]; then
+    echo "$NAME.json: no instruction count in the function records" >&2
+    exit 1
+  fi
+
+  read SECONDS_ RSS < $NAME.time
+  US=`awk "BEGIN { printf \"%.3f\", $SECONDS_ * 1000000 / ($INSTRUCTIONS + 1) }"`
+
+  echo "$AXIS,$FUNCTIONS,$DEPTH,$BLOCK,$FIELDS,$FANOUT,$INSTRUCTIONS,$SECONDS_,$US,$RSS" >> $RESULTS
+  printf "%-10s %-8s %12s instructions %8ss %10s us/inst %10s KB\n" $AXIS $2 $INSTRUCTIONS $SECONDS_ $US $RSS
+}
+
+# Compare the time per instruction of the first and last module of a sweep.
+check() {
+  AXIS=$1
+  FIRST=`grep "^$AXIS," $RESULTS | head -1 | cut -d, -f9`
+  LAST=`grep "^$AXIS," $RESULTS | tail -1 | cut -d, -f9`
+
+  if awk "BEGIN { exit !($LAST > $FIRST * $SUPERLINEAR_RATIO && $LAST > 1) }"; then
+    echo "SUPERLINEAR: $AXIS ($FIRST -> $LAST us/inst)"
+    STATUS=1
+  fi
+}
+
+echo "--> Functions"
+for N in 100 1000 10000; do FUNCTIONS=$N; run functions $N; done; FUNCTIONS=100; check functions
+
+echo "--> Loop nest depth"
+for N in 1 4 8 16; do DEPTH=$N; run depth $N; done; DEPTH=2; check depth
+
+echo "--> Basic block size"
+for N in 100 1000 10000; do BLOCK=$N; run block $N; done; BLOCK=50; check block
+
+echo "--> Struct fields"
+for N in 8 100 1000; do FIELDS=$N; run fields $N; done; FIELDS=8; check fields
+
+echo "--> Call fan-out"
+for N in 1 10 100; do FANOUT=$N; run fanout $N; done; FANOUT=2; check fanout
+
+echo "--> Results in $RESULTS"
+exit $STATUS